@@ -0,0 +1,273 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <common/nfa.h>
+#include <common/dfa.h>
+#include <common/lexer.h>
+#include <common/cfg.h>
+#include <common/regex.h>
+#include <common/workload.h>
+
+// each run returns something derived from its result, which is folded into sink so the
+// compiler can't drop the work
+struct benchmark {
+    std::string name;
+    std::function<size_t()> run;
+    size_t bytes;  // input processed per run, 0 when throughput isn't meaningful
+};
+
+struct bench_result {
+    long long iterations;
+    double medianNs;
+    double minNs;
+};
+
+volatile size_t sink = 0;
+
+double _elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// one warmup run sizes the rounds so that all of them together take about minTime seconds,
+// then the median and fastest per-iteration times over the rounds are reported
+bench_result _measure(benchmark& b, double minTime, int rounds) {
+    auto start = std::chrono::steady_clock::now();
+    sink = sink + b.run();
+    double once = std::max(_elapsedNs(start), 1.0);
+
+    long long iterations = std::max(1LL, (long long)(minTime * 1e9 / rounds / once));
+    std::vector<double> perIteration;
+    for (int r = 0; r < rounds; r++) {
+        start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; i++) sink = sink + b.run();
+        perIteration.push_back(_elapsedNs(start) / iterations);
+    }
+    std::sort(perIteration.begin(), perIteration.end());
+
+    bench_result result;
+    result.iterations = iterations * rounds;
+    result.medianNs = perIteration[perIteration.size() / 2];
+    result.minNs = perIteration[0];
+    return result;
+}
+
+std::vector<benchmark> buildBenchmarks() {
+    std::vector<benchmark> benchmarks;
+    std::map<int, std::string> rsmap = llre().getReverseSymbolMap();
+
+    // subset construction and minimization on automata with exponential blow-up
+    for (int n : {6, 10}) {
+        std::string suffix = "/blowup-" + std::to_string(n);
+        NFA nfa(blowupDefinition(n));
+        benchmarks.push_back({"nfa.toDFA" + suffix, [nfa]() mutable {
+            return (size_t)nfa.toDFA().isAccepting(0);
+        }, 0});
+
+        DFA raw = nfa.toDFA();
+        benchmarks.push_back({"dfa.optimize" + suffix, [raw]() {
+            DFA dfa = raw;
+            dfa.optimize();
+            return (size_t)dfa.isAccepting(0);
+        }, 0});
+    }
+
+    // anchored matching of a long identifier
+    {
+        RegexCache cache;
+        DFA dfa = cache.compileDFA("a-z(a-z|0-9)*", keywordTokens(0).alphabet);
+        std::string input(1 << 20, 'a');
+        for (size_t i = 0; i < input.size(); i += 7) input[i] = '0' + i % 10;
+        input[0] = 'a';
+        benchmarks.push_back({"dfa.match/id-1M", [dfa, input]() mutable {
+            return (size_t)dfa.match(input).second;
+        }, input.size()});
+    }
+
+    // a large DFA walked in its subset construction numbering and after reorderStates
+    {
+        DFA dfa = NFA(blowupDefinition(12)).toDFA();
+        DFA reordered = dfa;
+        reordered.reorderStates();
+        std::string input(1 << 20, 'a');
+        unsigned int bits = 1;
+        for (char& c : input) {
+            bits = bits * 1103515245 + 12345;
+            c = (bits >> 16) & 1 ? 'a' : 'b';
+        }
+        benchmarks.push_back({"dfa.match/blowup-12", [dfa, input]() mutable {
+            return (size_t)dfa.match(input).second;
+        }, input.size()});
+        benchmarks.push_back({"dfa.match/blowup-12-reordered", [reordered, input]() mutable {
+            return (size_t)reordered.match(input).second;
+        }, input.size()});
+    }
+
+    // scanning generated programs, with few and many keyword tokens
+    for (int keywords : {8, 64}) {
+        workload_tokens def = keywordTokens(keywords);
+        RegexCache cache;
+        std::vector<DFA> dfas;
+        std::vector<std::string> names;
+        for (workload_token& tok : def.tokens) {
+            dfas.push_back(cache.compileDFA(tok.regex, def.alphabet));
+            names.push_back(tok.name);
+        }
+        Lexer lex(def.alphabet, dfas, names, std::vector<std::string>(names.size()));
+        std::string source = keywordSource(keywords, 20000, 1);
+        benchmarks.push_back({"lexer.tokenize/kw" + std::to_string(keywords), [lex, source]() mutable {
+            return lex.tokenize(source).size();
+        }, source.size()});
+    }
+
+    // regex front end and Thompson construction over a typical token set
+    {
+        workload_tokens def = keywordTokens(64);
+        std::vector<std::string> regexes;
+        for (workload_token& tok : def.tokens) regexes.push_back(tok.regex);
+        regexes.push_back(blowupRegex(8));
+
+        benchmarks.push_back({"regex.parse/kw64", [regexes]() {
+            size_t nodes = 0;
+            for (const std::string& regex : regexes) nodes += parseRegex(regex).size();
+            return nodes;
+        }, 0});
+
+        std::vector<ParseTree> asts;
+        for (const std::string& regex : regexes) asts.push_back(parseRegex(regex));
+        benchmarks.push_back({"regex.nfa/kw64", [asts, rsmap, def]() mutable {
+            size_t built = 0;
+            for (ParseTree& ast : asts) {
+                NFABuilder nfa = nfaRegex(ast, def.alphabet, rsmap);
+                built++;
+            }
+            return built;
+        }, 0});
+    }
+
+    // LL(1) table construction and table-driven parsing
+    for (int keywords : {16, 128}) {
+        std::istringstream grammar(keywordGrammar(keywords));
+        CFG cfg = CFG::parse(grammar);
+        benchmarks.push_back({"cfg.stateTableLL1/kw" + std::to_string(keywords), [cfg]() mutable {
+            return cfg.stateTableLL1().size();
+        }, 0});
+    }
+    {
+        std::istringstream grammar(keywordGrammar(16));
+        CFG cfg = CFG::parse(grammar);
+        std::vector<token> tokens = keywordTokenStream(16, 20000, 1);
+        benchmarks.push_back({"cfg.match/kw16", [cfg, tokens]() mutable {
+            return (size_t)cfg.match(tokens).second.size();
+        }, 0});
+    }
+
+    return benchmarks;
+}
+
+void printHelp() {
+    std::cout << "USAGE:" << std::endl;
+    std::cout << "\tBENCH [--filter SUBSTRING] [--min-time SECONDS] [--rounds N] [--json]" << std::endl;
+    std::cout << "\t--filter SUBSTRING\tonly run benchmarks whose name contains SUBSTRING" << std::endl;
+    std::cout << "\t--min-time SECONDS\ttime spent measuring each benchmark (default 1)" << std::endl;
+    std::cout << "\t--rounds N\t\tnumber of timed rounds the median is taken over (default 5)" << std::endl;
+    std::cout << "\t--json\t\t\tprint one JSON object per benchmark instead of a table" << std::endl;
+}
+
+// checked flag values, false unless arg is entirely a number in range
+bool _seconds(const std::string& arg, double& value) {
+    try {
+        size_t used;
+        double seconds = std::stod(arg, &used);
+        if (used == arg.size() && std::isfinite(seconds) && seconds >= 0) {
+            value = seconds;
+            return true;
+        }
+    } catch (std::exception&) {}
+    return false;
+}
+
+bool _rounds(const std::string& arg, int& value) {
+    try {
+        size_t used;
+        int rounds = std::stoi(arg, &used);
+        if (used == arg.size() && rounds >= 1) {
+            value = rounds;
+            return true;
+        }
+    } catch (std::exception&) {}
+    return false;
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double minTime = 1;
+    int rounds = 5;
+    bool json = false;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc) {
+            if (!_seconds(argv[++i], minTime)) {
+                std::cerr << "ERROR: expected a non-negative number of seconds after --min-time but got '" << argv[i] << "'" << std::endl;
+                printHelp();
+                return 1;
+            }
+        }
+        else if (arg == "--rounds" && i + 1 < argc) {
+            if (!_rounds(argv[++i], rounds)) {
+                std::cerr << "ERROR: expected a positive number of rounds after --rounds but got '" << argv[i] << "'" << std::endl;
+                printHelp();
+                return 1;
+            }
+        }
+        else if (arg == "--json") json = true;
+        else {
+            std::cerr << "ERROR: unexpected argument '" << arg << "'" << std::endl;
+            printHelp();
+            return 1;
+        }
+    }
+
+#ifndef __OPTIMIZE__
+    std::cerr << "WARNING: BENCH was built without optimization, configure with -DCMAKE_BUILD_TYPE=Release" << std::endl;
+#endif
+
+    std::vector<benchmark> benchmarks;
+    try {
+        benchmarks = buildBenchmarks();
+    } catch (int e) {
+        return e;
+    }
+
+    if (!json) {
+        std::cout << std::left << std::setw(32) << "benchmark" << std::right << std::setw(12) << "iterations"
+                  << std::setw(16) << "median ns/op" << std::setw(16) << "min ns/op" << std::setw(12) << "MB/s" << std::endl;
+    }
+    for (benchmark& b : benchmarks) {
+        if (b.name.find(filter) == std::string::npos) continue;
+        bench_result r = _measure(b, minTime, rounds);
+        double mbps = b.bytes > 0 ? b.bytes / r.medianNs * 1e9 / (1 << 20) : 0;
+
+        if (json) {
+            std::cout << "{\"name\": \"" << b.name << "\", \"iterations\": " << r.iterations
+                      << ", \"median_ns\": " << std::fixed << std::setprecision(1) << r.medianNs
+                      << ", \"min_ns\": " << r.minNs;
+            if (b.bytes > 0) std::cout << ", \"mb_per_s\": " << mbps;
+            std::cout << "}" << std::endl;
+        }
+        else {
+            std::cout << std::left << std::setw(32) << b.name << std::right << std::setw(12) << r.iterations
+                      << std::fixed << std::setprecision(1) << std::setw(16) << r.medianNs << std::setw(16) << r.minNs;
+            if (b.bytes > 0) std::cout << std::setw(12) << mbps;
+            std::cout << std::endl;
+        }
+    }
+
+    return 0;
+}
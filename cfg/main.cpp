@@ -4,21 +4,26 @@
 #include <common/cfg.h>
 #include <common/serialization.h>
 #include <common/tree.h>
+#include <common/stats.h>
 
 void printHelp() {
     std::cout << "USAGE:" << std::endl;
-    std::cout << "\tCFG [definition_path]" << std::endl;
+    std::cout << "\tCFG [definition_path] [--stats[=json]]" << std::endl;
 }
 
 int main(int argc, char** argv) {
+    statsInit(argc, argv);
+
     if(argc < 2) {
         std::cerr << "ERROR: expected cfg file path" << std::endl;
         printHelp();
     }
     std::string cfgFile = argv[1];
 
+    StatsPhase grammarPhase("read grammar");
     std::ifstream cfgStream(cfgFile);
     CFG cfg = CFG::parse(cfgStream);
+    grammarPhase.stop();
 
     std::cout << cfg.formatForLGA() << std::endl;
     // for (std::string sym : cfg.getSymbols()) {
@@ -33,8 +38,15 @@ int main(int argc, char** argv) {
     // std::cout << cfg.derivesToLambda("K") << std::endl;
     // std::cout << cfg.printAllPredictSets() << std::endl;
 
-    std::cout << cfg.stateTableLL1() << std::endl;
+    StatsPhase tablePhase("ll1 table");
+    std::map<int, std::map<int, int>> table = cfg.stateTableLL1();
+    tablePhase.stop();
+    std::cout << table << std::endl;
+
+    StatsPhase parsePhase("parse");
     std::pair<bool, ParseTree> matchResults = cfg.match("oparen plus two oparen mult three two two cparen cparen");
+    parsePhase.stop();
+    statsSet("tree nodes", matchResults.second.size());
     // std::pair<bool, ParseTree> matchResults = cfg.match("oparen mult two three cparen");
     std::cout << "MATCH: " << (matchResults.first ? "TRUE" : "FALSE") << std::endl;
     cfg.printParseTree(matchResults.second);
@@ -4,6 +4,7 @@
 #include "setUtils.h"
 #include "tree.h"
 #include "lexer.h"
+#include "trace.h"
 
 #include <istream>
 #include <fstream>
@@ -338,86 +339,272 @@ std::pair<bool, ParseTree> CFG::match(std::string str) {
     return match(tokenStream);
 }
 
-std::pair<bool, ParseTree> CFG::match(std::vector<token> tokenStream) {
+std::pair<bool, ParseTree> CFG::match(const std::vector<token>& tokenStream) {
     std::map<std::string, sdtcallback> emptyTranslations;
     return match(tokenStream, emptyTranslations);
 }
 
-std::pair<bool, ParseTree> CFG::match(std::vector<token> tokenStream, std::map<std::string, sdtcallback> translations) {
-    token t;
-    t.type = "$";
-    t.value = "";
-    tokenStream.push_back(t);
+// the tokens are read in place, the session only holds the derivation stack and tree
+std::pair<bool, ParseTree> CFG::match(const std::vector<token>& tokenStream, const std::map<std::string, sdtcallback>& translations) {
+    ParseSession session;
+    VectorTokenSource source(tokenStream);
+    bool accepted = match(session, source, translations);
+    return std::make_pair(accepted, std::move(session.tree));
+}
+
+void ParseSession::reset() {
+    tokens.clear();
+    derivationStack.clear();
+    tree.clear();
+    nodeStart.clear();
+    nodeLength.clear();
+    accepted = false;
+    translated = false;
+}
+
+// the LL(1) table only depends on the grammar, so build it once and keep it for every later parse
+std::map<int, std::map<int, int>>& CFG::cachedStateTable() {
+    if (!ll1Ready) {
+        TRACE_SCOPE("CFG::stateTableLL1");
+        ll1Table = stateTableLL1();
+        ll1Ready = true;
+    }
+    return ll1Table;
+}
+
+bool CFG::match(ParseSession& session) {
+    std::map<std::string, sdtcallback> emptyTranslations;
+    return match(session, emptyTranslations);
+}
+
+bool CFG::match(ParseSession& session, const std::map<std::string, sdtcallback>& translations) {
+    VectorTokenSource source(session.tokens);
+    return match(session, source, translations);
+}
 
-    std::map<int, std::map<int, int>> ll1 = stateTableLL1();
+bool CFG::match(ParseSession& session, TokenSource& source) {
+    std::map<std::string, sdtcallback> emptyTranslations;
+    return match(session, source, emptyTranslations);
+}
 
+bool CFG::match(ParseSession& session, TokenSource& source, const std::map<std::string, sdtcallback>& translations) {
+    TRACE_SCOPE("CFG::match");
     std::map<int, sdtcallback> encodedTranslations;
     for (std::pair<std::string, sdtcallback> translatePair : translations) {
         encodedTranslations[symbolMap[translatePair.first]] = translatePair.second;
     }
+    return drive(session, source, encodedTranslations, false, 0, 0, 0);
+}
 
-    ParseTree parseTree;
-    int parseRoot = parseTree.addNode(-1, EMPTY_METADATA);
-    int parseNode = parseRoot;
+// reparses session.tokens after removedTokens tokens at editStart were replaced by insertedTokens
+// new ones. Subtrees of the previous parse are linked into the new tree in place rather than
+// reparsed whenever their nonterminal gets expanded at the same (shifted) position and their
+// tokens plus the one token of lookahead after them lie outside the edit. Translations rewrite
+// finished subtrees in place, so only untranslated parses can be reused this way
+bool CFG::rematch(ParseSession& session, int editStart, int removedTokens, int insertedTokens) {
+    TRACE_SCOPE("CFG::rematch");
+    std::map<int, sdtcallback> noTranslations;
+
+    // nodes dropped by earlier rematches stay in the tree's storage, so start over once they dominate
+    VectorTokenSource source(session.tokens);
+    // translated subtrees no longer match what the grammar derives, so they're never reused
+    if (!session.accepted || session.translated || session.tree.size() > 2 * session.compactSize + 1024) {
+        return drive(session, source, noTranslations, false, 0, 0, 0);
+    }
+    return drive(session, source, noTranslations, true, editStart, removedTokens, insertedTokens);
+}
 
-    std::vector<int> derivationStack;
-    derivationStack.push_back(goalSymbol);
+bool CFG::drive(ParseSession& session, TokenSource& source, std::map<int, sdtcallback>& encodedTranslations, bool reuse, int editStart, int removedTokens, int insertedTokens) {
+    std::map<int, std::map<int, int>>& ll1 = cachedStateTable();
+
+    std::vector<int>& derivationStack = session.derivationStack;
+    ParseTree& parseTree = session.tree;
+    std::vector<int>& nodeStart = session.nodeStart;
+    std::vector<int>& nodeLength = session.nodeLength;
+    int oldRoot = parseTree.rootNode();
+    derivationStack.clear();
+    if (!reuse) parseTree.clear();
+    session.accepted = false;
+    session.translated = !encodedTranslations.empty();
+
+    // one token of lookahead is pulled from the source at a time. Once it runs dry the lookahead
+    // is an implicit $, and the parse is over when that $ has been matched
     int stackPos = 0;
+    bool endMatched = false;
+    const token* current = nullptr;
+    int currentSymbol = endSymbol;
+    auto pull = [&]() {
+        current = source.next();
+        currentSymbol = endSymbol;
+        if (current != nullptr) {
+            auto itr = symbolMap.find(current->type);
+            currentSymbol = itr == symbolMap.end() ? -1 : itr->second;
+        }
+    };
+    auto advance = [&](int count) {
+        if (count == 0) return;
+        if (current == nullptr) {
+            endMatched = true;
+            stackPos++;
+            return;
+        }
+        int skipped = count > 1 ? source.skip(count - 1) : 0;
+        stackPos += 1 + skipped;
+        pull();
+        // the stream ran out inside the skipped span, so it ended with the $
+        if (skipped < count - 1) {
+            endMatched = true;
+            stackPos++;
+        }
+    };
+    pull();
+
+    auto addNode = [&](int label, const tree_metadata& meta, int length) {
+        int node = parseTree.addNode(label, meta);
+        if (node >= nodeStart.size()) {
+            nodeStart.resize(node + 1);
+            nodeLength.resize(node + 1);
+        }
+        nodeStart[node] = stackPos;
+        nodeLength[node] = length;
+        return node;
+    };
+    auto closeNode = [&](int node) {
+        if (node < nodeStart.size()) nodeLength[node] = stackPos - nodeStart[node];
+    };
+
+    // walks the previous tree alongside the parse. Positions only ever move forward, so the
+    // path to the outermost old node starting at a position is found by skipping finished
+    // siblings and descending into the node that covers it
+    struct cursor_frame {
+        int node;
+        int start;
+        int index;  // position among the parent's children
+    };
+    std::vector<cursor_frame> cursor;
+    if (reuse) cursor.push_back({oldRoot, 0, 0});
+    auto outermostAt = [&](int oldPos) {
+        while (!cursor.empty()) {
+            cursor_frame f = cursor.back();
+            if (f.start == oldPos) return f.node;
+
+            int end = f.start + nodeLength[f.node];
+            std::vector<int>* children = parseTree.getChildren(f.node);
+            if (end > oldPos && f.start < oldPos && !children->empty()) {
+                cursor.push_back({children->at(0), f.start, 0});
+                continue;
+            }
 
-    while (stackPos < tokenStream.size()) {
-        int s = derivationStack[derivationStack.size() - 1];
-        derivationStack.pop_back();
-
-        // std::cout << s << ":" << derivationStack << " <==> " << stackPos << std::endl;
-        // std::cout << "SYM: " << c << "S"
-
-        if (s == -1) {
-            parseNode = parseTree.getParent(parseNode);
-            continue;
+            // the node ends before oldPos: move on to the next sibling, climbing up when out of them
+            cursor.pop_back();
+            while (!cursor.empty()) {
+                std::vector<int>* siblings = parseTree.getChildren(cursor.back().node);
+                if (f.index + 1 < siblings->size()) {
+                    cursor.push_back({siblings->at(f.index + 1), end, f.index + 1});
+                    break;
+                }
+                f = cursor.back();
+                cursor.pop_back();
+            }
+        }
+        return -1;
+    };
+
+    int shift = insertedTokens - removedTokens;
+    auto reusableNode = [&](int label, int pos) {
+        if (!reuse) return -1;
+        int oldPos;
+        if (pos < editStart) oldPos = pos;
+        else if (pos >= editStart + insertedTokens) oldPos = pos - shift;
+        else return -1;
+
+        // every first descendant of the outermost node starts at the same position
+        for (int node = outermostAt(oldPos); node != -1; ) {
+            if (parseTree.getLabel(node) == label && (oldPos >= editStart || oldPos + nodeLength[node] < editStart)) {
+                return node;
+            }
+            std::vector<int>* children = parseTree.getChildren(node);
+            node = children->empty() ? -1 : children->at(0);
         }
+        return -1;
+    };
 
-        int nextParseNode = parseTree.addNode(s, EMPTY_METADATA);
-        parseTree.addChild(parseNode, nextParseNode);
-        parseNode = nextParseNode;
+    int parseRoot = addNode(-1, EMPTY_METADATA, 0);
+    int parseNode = parseRoot;
 
-        int c = symbolMap[tokenStream[stackPos].type];
-        std::map<int, int> tableRow = ll1[s];
-        if (tableRow.find(c) == tableRow.end()) {
-            std::cerr << "ERROR: unexpected token \'" << reverseSymbolMap[c] << "\' in position " << stackPos << std::endl;
-            std::cout << derivationStack << std::endl;
-            return std::make_pair(false, parseTree);
-        }
-        int applyRule = tableRow[c];
-        GrammarRule rule = rules[s][applyRule];
-        derivationStack.push_back(-1); // rule term: signifies moving up to parent node
-        for (int i=rule.size()-1; i>=0; i--) derivationStack.push_back(rule[i]);
+    derivationStack.push_back(goalSymbol);
+
+    // pops rule ends, matched terminals and lambdas off the stack until a nonterminal needs expanding
+    auto settle = [&]() {
         for (int i=derivationStack.size()-1; i>=0; i--) {
             if (derivationStack[i] == -1) {
                 performTranslation(encodedTranslations, parseTree, parseNode);
+                closeNode(parseNode);
                 parseNode = parseTree.getParent(parseNode);
                 derivationStack.pop_back();
             }
-            else if (derivationStack[i] == symbolMap[tokenStream[stackPos].type]) {
+            else if (derivationStack[i] == currentSymbol) {
                 tree_metadata meta;
-                meta.value = tokenStream[stackPos].value;
-                int tokenNode = parseTree.addNode(symbolMap[tokenStream[stackPos].type], meta);
+                if (current != nullptr) meta.value = current->value;
+                int tokenNode = addNode(derivationStack[i], meta, 1);
                 parseTree.addChild(parseNode, tokenNode);
 
-                stackPos++;
+                advance(1);
                 derivationStack.pop_back();
             }
             else if (derivationStack[i] == lambdaSymbol) derivationStack.pop_back();
             else break;
         }
+    };
+
+    while (!endMatched && !derivationStack.empty()) {
+        int s = derivationStack[derivationStack.size() - 1];
+        derivationStack.pop_back();
+
+        if (s == -1) {
+            closeNode(parseNode);
+            parseNode = parseTree.getParent(parseNode);
+            continue;
+        }
+
+        int reused = reusableNode(s, stackPos);
+        if (reused != -1) {
+            parseTree.addChild(parseNode, reused);
+            advance(nodeLength[reused]);
+            settle();
+            continue;
+        }
+
+        int nextParseNode = addNode(s, EMPTY_METADATA, 0);
+        parseTree.addChild(parseNode, nextParseNode);
+        parseNode = nextParseNode;
+
+        int c = currentSymbol;
+        std::map<int, int>& tableRow = ll1[s];
+        auto ruleItr = tableRow.find(c);
+        if (ruleItr == tableRow.end()) {
+            std::string found = c == -1 ? current->type : reverseSymbolMap[c];
+            std::cerr << "ERROR: unexpected token \'" << found << "\' in position " << stackPos << std::endl;
+            std::cout << derivationStack << std::endl;
+            // the partial tree hangs off the placeholder root, also after a rematch
+            parseTree.setRoot(parseRoot);
+            return false;
+        }
+        GrammarRule& rule = rules[s][ruleItr->second];
+        derivationStack.push_back(-1); // rule term: signifies moving up to parent node
+        for (int i=rule.size()-1; i>=0; i--) derivationStack.push_back(rule[i]);
+        settle();
     }
 
     // set new root to user-defined goal nonterminal
-    parseTree.setRoot(parseTree.getChildren(parseTree.rootNode())->at(0));
+    parseTree.setRoot(parseTree.getChildren(parseRoot)->at(0));
 
-    return std::make_pair(derivationStack.size() == 0, parseTree);
+    if (!reuse) session.compactSize = parseTree.size();
+    session.accepted = derivationStack.size() == 0 && endMatched;
+    return session.accepted;
 }
 
-void CFG::performTranslation(std::map<int, sdtcallback> translations, ParseTree &tree, int node) {
+void CFG::performTranslation(std::map<int, sdtcallback>& translations, ParseTree &tree, int node) {
     int label = tree.getLabel(node);
     if (translations.find(label) != translations.end()) {
         (*translations[label])(tree, node, symbolMap);
@@ -489,14 +676,15 @@ std::string CFG::formatForLGA() {
     return ss.str();
 }
 
-void CFG::printParseTree(ParseTree t) {
-    std::cout << t.toString(reverseSymbolMap) << std::endl;
+void CFG::printParseTree(ParseTree& t) {
+    t.write(std::cout, reverseSymbolMap);
+    std::cout << std::endl;
 }
 
-void CFG::saveGraphvizTree(std::string file, ParseTree t) {
+void CFG::saveGraphvizTree(std::string file, ParseTree& t) {
     std::ofstream fileOut(file);
     std::map<int, std::string> rsm = reverseSymbolMap;
     rsm[-1] = "ROOT";
-    fileOut << t.toGraphviz(rsm);
+    t.writeGraphviz(fileOut, rsm);
     fileOut.close();
 }
@@ -10,6 +10,26 @@
 typedef std::vector<int> GrammarRule;
 typedef void (*sdtcallback)(ParseTree&, int, std::map<std::string, int>&);
 
+// owns the buffers used by CFG::match so that many small inputs can be parsed back to back
+// without reallocating. reset() empties everything but keeps the allocated memory around
+class ParseSession {
+    public:
+        std::vector<token> tokens;
+        std::vector<int> derivationStack;
+        ParseTree tree;
+        bool accepted = false;
+
+        // number of tokens under every tree node, which stays valid when CFG::rematch links a
+        // subtree into a later parse at a shifted position. nodeStart only holds for nodes
+        // created by the latest parse
+        std::vector<int> nodeStart;
+        std::vector<int> nodeLength;
+        int compactSize = 0;  // tree size right after the last full parse
+        bool translated = false;  // whether translations rewrote the tree of the last parse
+
+        void reset();
+};
+
 class CFG {
     private:
     int terminalThreshold; // all i > terminalThreshold implies i is a terminal
@@ -22,6 +42,11 @@ class CFG {
     std::map<int, std::string> reverseSymbolMap;
     std::map<int, std::vector<GrammarRule>> rules;
 
+    bool ll1Ready = false;
+    std::map<int, std::map<int, int>> ll1Table;
+    std::map<int, std::map<int, int>>& cachedStateTable();
+    bool drive(ParseSession& session, TokenSource& source, std::map<int, sdtcallback>& encodedTranslations, bool reuse, int editStart, int removedTokens, int insertedTokens);
+
     public:
     static CFG parse(std::istream &is);
     bool isTerminal(std::string symStr);
@@ -49,16 +74,21 @@ class CFG {
     std::set<int> predictSet(int sym, GrammarRule rule);
 
     std::pair<bool, ParseTree> match(std::string str);
-    std::pair<bool, ParseTree> match(std::vector<token> tokenStream);
-    std::pair<bool, ParseTree> match(std::vector<token> tokenStream, std::map<std::string, sdtcallback> translations);
+    std::pair<bool, ParseTree> match(const std::vector<token>& tokenStream);
+    std::pair<bool, ParseTree> match(const std::vector<token>& tokenStream, const std::map<std::string, sdtcallback>& translations);
+    bool match(ParseSession& session);
+    bool match(ParseSession& session, const std::map<std::string, sdtcallback>& translations);
+    bool match(ParseSession& session, TokenSource& source);
+    bool match(ParseSession& session, TokenSource& source, const std::map<std::string, sdtcallback>& translations);
+    bool rematch(ParseSession& session, int editStart, int removedTokens, int insertedTokens);
     std::string printAllPredictSets();
 
     std::map<int, std::map<int, int>> stateTableLL1();
     
     // syntax directed translation
-    void performTranslation(std::map<int, sdtcallback> translations, ParseTree &tree, int node);
+    void performTranslation(std::map<int, sdtcallback>& translations, ParseTree &tree, int node);
 
     std::string formatForLGA();
-    void printParseTree(ParseTree t);
-    void saveGraphvizTree(std::string file, ParseTree t);
+    void printParseTree(ParseTree& t);
+    void saveGraphvizTree(std::string file, ParseTree& t);
 };
@@ -0,0 +1,257 @@
+#include <map>
+#include <functional>
+#include "codegen.h"
+
+std::string cppIdentifier(const std::string& text) {
+    std::string id;
+    for (char c : text) {
+        bool alnum = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        id.push_back(alnum ? c : '_');
+    }
+    if (id.empty() || (id[0] >= '0' && id[0] <= '9')) id = "_" + id;
+    return id;
+}
+
+// octal escapes are always three digits, so unlike \x they can't swallow a following character
+std::string cppStringLiteral(const std::string& text) {
+    std::string literal = "\"";
+    for (char c : text) {
+        unsigned char u = c;
+        if (c == '"' || c == '\\') {
+            literal.push_back('\\');
+            literal.push_back(c);
+        }
+        else if (u >= 0x20 && u < 0x7f && c != '?') literal.push_back(c);
+        else {
+            literal.push_back('\\');
+            literal.push_back('0' + (u >> 6));
+            literal.push_back('0' + ((u >> 3) & 7));
+            literal.push_back('0' + (u & 7));
+        }
+    }
+    literal.push_back('"');
+    return literal;
+}
+
+void _writePrologue(std::ostream& os, const std::string& name, const std::string& source) {
+    os << "// generated from " << source << ", do not edit" << std::endl;
+    os << "#pragma once" << std::endl << std::endl;
+    os << "#include <cstdint>" << std::endl;
+    os << "#include <string_view>" << std::endl << std::endl;
+    os << "namespace " << name << " {" << std::endl << std::endl;
+}
+
+void _writeTokenNames(std::ostream& os, const std::vector<std::string>& tokens, const std::vector<std::string>& tokenData) {
+    os << "constexpr int tokenCount = " << tokens.size() << ";" << std::endl;
+    os << "constexpr std::string_view tokenNames[tokenCount] = {";
+    for (int i = 0; i < tokens.size(); i++) os << (i > 0 ? ", " : " ") << cppStringLiteral(tokens[i]);
+    os << " };" << std::endl;
+    os << "// replacement value of each token, empty when the matched text is the value" << std::endl;
+    os << "constexpr std::string_view tokenValues[tokenCount] = {";
+    for (int i = 0; i < tokenData.size(); i++) os << (i > 0 ? ", " : " ") << cppStringLiteral(tokenData[i]);
+    os << " };" << std::endl << std::endl;
+
+    os << R"(struct token {
+    int type;  // index into tokenNames and tokenValues
+    int offset;
+    int length;
+};
+
+)";
+}
+
+// the driver loop over next(), which both scanner flavors share
+void _writeTokenize(std::ostream& os, const std::string& specifier) {
+    os << R"(// calls emit(token) for each token of text. Returns -1 once all of text is scanned, otherwise
+// the offset where no (non-empty) token matches
+template <typename Emit>
+)" << specifier << R"( int tokenize(std::string_view text, Emit&& emit) {
+    int pos = 0;
+    while (pos < (int)text.size()) {
+        int length;
+        int type = next(text, pos, length);
+        if (type < 0 || length == 0) return pos;
+        emit(token{ type, pos, length });
+        pos += length;
+    }
+    return -1;
+}
+
+)";
+}
+
+// one label per state. Bytes are grouped by target so each state is a single switch, and a
+// state's acceptance is recorded on entry through `accept`, which is spliced in per state
+void _writeDirectStates(std::ostream& os, int states, std::function<int(int, unsigned char)> transition,
+                        std::function<std::string(int)> accept, std::function<std::string(unsigned char)> dead) {
+    os << "    goto s0;" << std::endl;
+    for (int s = 0; s < states; s++) {
+        os << "s" << s << ":" << std::endl;
+        std::string onEntry = accept(s);
+        if (!onEntry.empty()) os << "    " << onEntry << std::endl;
+        os << "    if (p == end) goto done;" << std::endl;
+        os << "    switch ((unsigned char)*p++) {" << std::endl;
+
+        // bytes with nowhere to go are grouped by what happens instead, the biggest group is the default
+        std::map<int, std::vector<int>> targets;
+        std::map<std::string, std::vector<int>> deadEnds;
+        for (int b = 0; b < 256; b++) {
+            int to = transition(s, b);
+            if (to != -1) targets[to].push_back(b);
+            else {
+                std::string statement = dead(b);
+                deadEnds[statement.empty() ? "goto done;" : statement].push_back(b);
+            }
+        }
+        std::string fallback = "goto done;";
+        int fallbackSize = 0;
+        for (auto& deadEnd : deadEnds) {
+            if (deadEnd.second.size() > fallbackSize) {
+                fallback = deadEnd.first;
+                fallbackSize = deadEnd.second.size();
+            }
+        }
+
+        for (auto& target : targets) {
+            os << "        ";
+            for (int b : target.second) os << "case " << b << ": ";
+            os << "goto s" << target.first << ";" << std::endl;
+        }
+        for (auto& deadEnd : deadEnds) {
+            if (deadEnd.first == fallback) continue;
+            os << "        ";
+            for (int b : deadEnd.second) os << "case " << b << ": ";
+            os << deadEnd.first << std::endl;
+        }
+        os << "        default: " << fallback << std::endl;
+        os << "    }" << std::endl;
+    }
+}
+
+void writeScannerHeader(std::ostream& os, ScannerTable& scanner, const std::vector<std::string>& tokens,
+                        const std::vector<std::string>& tokenData, const std::string& name, const std::string& source) {
+    int states = scanner.stateCount();
+
+    // bytes whose columns agree in every state share a class, class 0 is everything outside the alphabet
+    std::vector<int> byteClasses(256, 0);
+    std::vector<unsigned char> classBytes = { 0 };
+    std::map<std::vector<int>, int> columns;
+    for (char c : scanner.getAlphabet()) {
+        std::vector<int> column;
+        for (int s = 0; s < states; s++) column.push_back(scanner.transition(s, c));
+        auto itr = columns.emplace(column, classBytes.size()).first;
+        if (itr->second == classBytes.size()) classBytes.push_back(c);
+        byteClasses[(unsigned char)c] = itr->second;
+    }
+    std::string stateType = states < (1 << 15) ? "std::int16_t" : "std::int32_t";
+    // every byte of the alphabet can get its own class, on top of class 0
+    std::string classType = classBytes.size() <= 256 ? "std::uint8_t" : "std::uint16_t";
+
+    _writePrologue(os, name, source);
+    _writeTokenNames(os, tokens, tokenData);
+
+    os << "constexpr int stateCount = " << states << ";" << std::endl;
+    os << "constexpr int classCount = " << classBytes.size() << ";" << std::endl;
+    os << "// column of the transition table for each byte, 0 for bytes outside the alphabet" << std::endl;
+    os << "constexpr " << classType << " byteClasses[256] = {";
+    for (int b = 0; b < 256; b++) os << (b % 32 == 0 ? "\n    " : " ") << byteClasses[b] << ",";
+    os << std::endl << "};" << std::endl;
+    os << "// next state, -1 once no token can match" << std::endl;
+    os << "constexpr " << stateType << " transitions[stateCount][classCount] = {" << std::endl;
+    for (int s = 0; s < states; s++) {
+        os << "    {";
+        for (int k = 0; k < classBytes.size(); k++) {
+            os << (k > 0 ? ", " : " ") << (k == 0 ? -1 : scanner.transition(s, classBytes[k]));
+        }
+        os << " }," << std::endl;
+    }
+    os << "};" << std::endl;
+    os << "// token accepted in each state, -1 for none" << std::endl;
+    os << "constexpr " << stateType << " acceptingTokens[stateCount] = {";
+    for (int s = 0; s < states; s++) os << (s % 32 == 0 ? "\n    " : " ") << scanner.acceptingToken(s) << ",";
+    os << std::endl << "};" << std::endl << std::endl;
+
+    os << R"(// longest match at pos, ties going to the token defined first. Returns the token type and sets
+// length, -1 if no token matches or -2 if a byte outside the alphabet is reached while some token
+// could still match
+constexpr int next(std::string_view text, int pos, int& length) {
+    int state = 0;
+    int type = -1;
+    length = 0;
+    for (int i = pos; ; i++) {
+        if (acceptingTokens[state] != -1) {
+            type = acceptingTokens[state];
+            length = i - pos;
+        }
+        if (i == (int)text.size()) break;
+        int byteClass = byteClasses[(unsigned char)text[i]];
+        if (byteClass == 0) return -2;
+        state = transitions[state][byteClass];
+        if (state == -1) break;
+    }
+    return type;
+}
+
+)";
+    _writeTokenize(os, "constexpr");
+    os << "}" << std::endl;
+}
+
+void writeDirectScannerHeader(std::ostream& os, ScannerTable& scanner, const std::vector<std::string>& tokens,
+                              const std::vector<std::string>& tokenData, const std::string& name, const std::string& source) {
+    std::vector<bool> inAlphabet(256, false);
+    for (char c : scanner.getAlphabet()) inAlphabet[(unsigned char)c] = true;
+
+    _writePrologue(os, name, source);
+    _writeTokenNames(os, tokens, tokenData);
+    os << R"(// longest match at pos, ties going to the token defined first. Returns the token type and sets
+// length, -1 if no token matches or -2 if a byte outside the alphabet is reached while some token
+// could still match
+inline int next(std::string_view text, int pos, int& length) {
+    const char* start = text.data() + pos;
+    const char* p = start;
+    const char* end = text.data() + text.size();
+    const char* accepted = start;
+    int type = -1;
+)";
+    _writeDirectStates(os, scanner.stateCount(),
+        [&](int s, unsigned char b) { return scanner.transition(s, b); },
+        [&](int s) {
+            int tok = scanner.acceptingToken(s);
+            if (tok == -1) return std::string();
+            return "type = " + std::to_string(tok) + "; accepted = p;";
+        },
+        [&](unsigned char b) { return inAlphabet[b] ? std::string() : std::string("return -2;"); });
+    os << R"(done:
+    length = accepted - start;
+    return type;
+}
+
+)";
+    _writeTokenize(os, "inline");
+    os << "}" << std::endl;
+}
+
+void writeDirectMatcherHeader(std::ostream& os, DFA& dfa, const std::string& name, const std::string& source) {
+    _writePrologue(os, name, source);
+    os << R"(// end of the longest match starting at pos, or -1 if no prefix of text[pos..] matches
+inline int longestMatch(std::string_view text, int pos) {
+    const char* p = text.data() + pos;
+    const char* end = text.data() + text.size();
+    const char* accepted = nullptr;
+)";
+    _writeDirectStates(os, dfa.stateCount(),
+        [&](int s, unsigned char b) { return dfa.transition(s, b); },
+        [&](int s) { return dfa.isAccepting(s) ? std::string("accepted = p;") : std::string(); },
+        [&](unsigned char) { return std::string(); });
+    os << R"(done:
+    return accepted == nullptr ? -1 : accepted - text.data();
+}
+
+inline bool matches(std::string_view text) {
+    return longestMatch(text, 0) == (int)text.size();
+}
+
+}
+)";
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "scanner.h"
+
+// writes a self-contained C++ header for a fixed token set: the combined scanner's tables as
+// constexpr arrays plus constexpr next/tokenize functions over them, all inside namespace `name`
+void writeScannerHeader(std::ostream& os, ScannerTable& scanner, const std::vector<std::string>& tokens,
+                        const std::vector<std::string>& tokenData, const std::string& name, const std::string& source);
+
+// the same scanner and interface, but direct-coded: one label per state, each a switch on the next
+// byte that jumps to the following state, so no tables exist at runtime
+void writeDirectScannerHeader(std::ostream& os, ScannerTable& scanner, const std::vector<std::string>& tokens,
+                              const std::vector<std::string>& tokenData, const std::string& name, const std::string& source);
+// a direct-coded matcher for a single DFA with longestMatch(text, pos) and matches(text)
+void writeDirectMatcherHeader(std::ostream& os, DFA& dfa, const std::string& name, const std::string& source);
+
+// turns an arbitrary string (e.g. a file name) into something usable as a C++ identifier
+std::string cppIdentifier(const std::string& text);
+std::string cppStringLiteral(const std::string& text);
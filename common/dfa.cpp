@@ -2,8 +2,11 @@
 #include <sstream>
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include "dfa.h"
 #include "serialization.h"
+#include "trace.h"
 
 DFA::DFA(std::vector<char> alphabet, std::map<int, StateInfo> states, transition_table<int> table) {
     this->alphabet = alphabet;
@@ -12,6 +15,7 @@ DFA::DFA(std::vector<char> alphabet, std::map<int, StateInfo> states, transition
 }
 
 void DFA::optimize() {
+    TRACE_SCOPE("DFA::optimize");
     int tableSize = this->states.size();
     int i = 0;
     while(i < 50) {
@@ -30,6 +34,7 @@ void DFA::optimize() {
 }
 
 void DFA::mergeStates() {
+    TRACE_SCOPE("DFA::mergeStates");
     std::set<state_set> merges;  // M in pseudocode
     std::vector<std::pair<state_set, std::vector<char>>> heads;  // L in pseudocode
 
@@ -108,6 +113,7 @@ void DFA::mergeStates() {
 }
 
 void DFA::pruneStates() {
+    TRACE_SCOPE("DFA::pruneStates");
     // we conduct pruning by a backwards and forwards pass on the DAG and taking the intersection
     // this process guarentees that there exists a path from the start and accept states
     state_set forwardPass;
@@ -208,18 +214,109 @@ void DFA::normalize() {
 
     this->table = normalized;
     this->states = normalizedStates;
+    this->flatTable.clear();
+}
+
+// normalize numbers states by their old ids, which says nothing about how matching moves
+// through them. Renumbering breadth-first from the start keeps states that are reached early and
+// together next to each other in the flat table
+void DFA::reorderStates() {
+    std::vector<int> order = { 0 };
+    std::map<int, bool> seen = { { 0, true } };
+    for (int q = 0; q < order.size(); q++) {
+        auto row = this->table.find(order[q]);
+        if (row == this->table.end()) continue;
+        for (auto& tableCell : row->second) {
+            int to = tableCell.second;
+            if (to == -1 || seen[to]) continue;
+            seen[to] = true;
+            order.push_back(to);
+        }
+    }
+    for (auto& s : this->states) {
+        if (!seen[s.first]) order.push_back(s.first);
+    }
+    applyOrder(order);
+}
+
+// orders states by how often matching the samples visits them, hottest first, so the states a
+// real workload spends its time in share cache lines. The start stays 0 and breadth-first order
+// breaks ties, which also places states the samples never reach
+void DFA::reorderStates(const std::vector<std::string>& samples) {
+    reorderStates();
+    if (flatTable.empty()) flatten();
+
+    std::vector<long long> visits(flatAccepting.size(), 0);
+    for (const std::string& sample : samples) {
+        int state = 0;
+        visits[state]++;
+        for (char c : sample) {
+            state = flatTable[state * 256 + (unsigned char)c];
+            if (state == -1) break;
+            visits[state]++;
+        }
+    }
+
+    std::vector<int> order;
+    for (int s = 1; s < visits.size(); s++) order.push_back(s);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return visits[a] > visits[b]; });
+    order.insert(order.begin(), 0);
+    applyOrder(order);
+}
+
+// order[i] is the state that becomes state i
+void DFA::applyOrder(const std::vector<int>& order) {
+    std::map<int, int> idMap;
+    idMap[-1] = -1;
+    for (int i = 0; i < order.size(); i++) idMap[order[i]] = i;
+
+    transition_table<int> reordered;
+    for (auto& tableRow : this->table) {
+        if (idMap.find(tableRow.first) == idMap.end()) continue;
+        for (auto& tableCell : tableRow.second) {
+            auto itr = idMap.find(tableCell.second);
+            reordered[idMap[tableRow.first]][tableCell.first] = itr == idMap.end() ? -1 : itr->second;
+        }
+    }
+
+    std::map<int, StateInfo> reorderedStates;
+    for (auto& infoPair : this->states) {
+        if (idMap.find(infoPair.first) != idMap.end()) reorderedStates[idMap[infoPair.first]] = infoPair.second;
+    }
+
+    this->table = reordered;
+    this->states = reorderedStates;
+    this->flatTable.clear();
+}
+
+void DFA::flatten() {
+    int stateCount = 1;  // a DFA pruned down to nothing still gets a rejecting start state
+    for (auto& s : this->states) stateCount = std::max(stateCount, s.first + 1);
+    for (auto& row : this->table) stateCount = std::max(stateCount, row.first + 1);
+
+    flatTable.assign(stateCount * 256, -1);
+    flatAccepting.assign(stateCount, false);
+    for (auto& row : this->table) {
+        for (auto& cell : row.second) {
+            flatTable[row.first * 256 + (unsigned char)cell.first] = cell.second;
+        }
+    }
+    for (auto& s : this->states) {
+        flatAccepting[s.first] = s.second.accepting;
+    }
 }
 
 std::pair<bool, int> DFA::match(std::string str) {
+    if (flatTable.empty()) flatten();
+
     int state = 0;  // zero is always the starting point by convention
     for (int pos = 0; pos < str.length(); pos++) {
-        std::map<char, int> tableRow = this->table[state];
-        int nextState = tableRow[str.at(pos)];
+        int nextState = flatTable[state * 256 + (unsigned char)str[pos]];
         if (nextState == -1) return std::make_pair(false, pos + 1);
         state = nextState;
     }
 
-    bool acc = this->states[state].accepting;
+    bool acc = flatAccepting[state];
     int accPos = str.length() + 1;
     // account for weird special case in grader for zero-length strings
     if(!acc && str.length() == 0) {
@@ -233,13 +330,125 @@ bool DFA::isMatch(std::string str) {
 }
 
 int DFA::transition(int state, char c) {
-    std::map<char, int> tableRow = this->table[state];
-    int nextState = tableRow[c];
-
-    return nextState;
+    if (flatTable.empty()) flatten();
+    if (state < 0) return -1;
+    return flatTable[state * 256 + (unsigned char)c];
 }
 bool DFA::isAccepting(int s) {
-    return this->states[s].accepting;
+    if (flatTable.empty()) flatten();
+    if (s < 0) return false;
+    return flatAccepting[s];
+}
+
+int DFA::stateCount() {
+    return this->states.size();
+}
+
+dfa_prefilter DFA::prefilter() {
+    if (flatTable.empty()) flatten();
+
+    dfa_prefilter pf;
+    pf.matchesEmpty = flatAccepting[0];
+    for (int c = 0; c < 256; c++) {
+        if (flatTable[c] != -1) pf.firstBytes.set(c);
+    }
+
+    // until a match could end, a state with a single way out forces the next character
+    state_set visited;
+    int state = 0;
+    while (!flatAccepting[state] && visited.find(state) == visited.end()) {
+        visited.insert(state);
+        int forced = -1;
+        int ways = 0;
+        for (int c = 0; c < 256 && ways < 2; c++) {
+            if (flatTable[state * 256 + c] != -1) {
+                forced = c;
+                ways++;
+            }
+        }
+        if (ways != 1) break;
+        pf.prefix.push_back((char)forced);
+        state = flatTable[state * 256 + forced];
+    }
+    return pf;
+}
+
+// true when the language is a single non-empty string, which is then stored in literal
+bool DFA::isLiteral(std::string& literal) {
+    dfa_prefilter pf = prefilter();
+    if (pf.matchesEmpty || pf.prefix.empty()) return false;
+
+    int state = 0;
+    for (char c : pf.prefix) state = flatTable[state * 256 + (unsigned char)c];
+    if (!flatAccepting[state]) return false;
+    for (int c = 0; c < 256; c++) {
+        if (flatTable[state * 256 + c] != -1) return false;
+    }
+
+    literal = pf.prefix;
+    return true;
+}
+
+// first position at or after pos where a match could begin, or -1
+size_t _nextCandidate(dfa_prefilter& pf, std::string_view text, size_t pos) {
+    if (pf.matchesEmpty) return pos;
+    if (pos >= text.size()) return std::string_view::npos;
+
+    if (pf.prefix.size() > 1) return text.find(pf.prefix, pos);
+    if (pf.prefix.size() == 1) {
+        const void* found = memchr(text.data() + pos, pf.prefix[0], text.size() - pos);
+        return found == nullptr ? std::string_view::npos : (const char*)found - text.data();
+    }
+    while (pos < text.size() && !pf.firstBytes.test((unsigned char)text[pos])) pos++;
+    return pos < text.size() ? pos : std::string_view::npos;
+}
+
+// end of the longest match starting at pos, or -1 if none starts there
+int DFA::longestMatch(std::string_view text, int pos) {
+    if (flatTable.empty()) flatten();
+
+    int state = 0;
+    int end = flatAccepting[state] ? pos : -1;
+    for (int i = pos; i < text.size(); i++) {
+        state = flatTable[state * 256 + (unsigned char)text[i]];
+        if (state == -1) break;
+        if (flatAccepting[state]) end = i + 1;
+    }
+    return end;
+}
+
+// leftmost-longest, non-overlapping [start, end) spans of every match in text. Candidate start
+// positions come from the prefilter so most of the text is never run through the table
+std::vector<std::pair<size_t, size_t>> DFA::findAll(std::string_view text) {
+    if (flatTable.empty()) flatten();
+    dfa_prefilter pf = prefilter();
+    std::vector<std::pair<size_t, size_t>> spans;
+
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        pos = _nextCandidate(pf, text, pos);
+        if (pos == std::string_view::npos) break;
+
+        // longestMatch, with offsets past what an int holds
+        int state = 0;
+        bool matched = flatAccepting[state];
+        size_t end = pos;
+        for (size_t i = pos; i < text.size(); i++) {
+            state = flatTable[state * 256 + (unsigned char)text[i]];
+            if (state == -1) break;
+            if (flatAccepting[state]) {
+                matched = true;
+                end = i + 1;
+            }
+        }
+        if (!matched) {
+            pos++;
+            continue;
+        }
+        spans.push_back(std::make_pair(pos, end));
+        pos = end > pos ? end : pos + 1;
+    }
+    return spans;
 }
 
 state_set DFA::getForwardConnected(int state) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <string_view>
 #include "serialization.h"
 
 template<typename T>
@@ -19,12 +20,25 @@ std::ostream& operator<<(std::ostream& os, const transition_table<T>& table) {
     return os;
 }
 
+// what every match of a DFA must look like at its start, used to skip ahead in a search
+struct dfa_prefilter {
+    std::string prefix;      // literal every match begins with
+    char_class firstBytes;   // characters a non-empty match can begin with
+    bool matchesEmpty;       // the start state accepts, so every position is a candidate
+};
+
 class DFA {
     private:
         std::vector<char> alphabet;
         std::map<int, StateInfo> states;
         transition_table<int> table;
 
+        // dense copy of table indexed by state * 256 + (unsigned char)c, built on first use
+        std::vector<int> flatTable;
+        std::vector<bool> flatAccepting;
+        void flatten();
+        void applyOrder(const std::vector<int>& order);
+
         state_set getForwardConnected(int state);
         state_set getBackwardConnected(int state);
 
@@ -32,12 +46,20 @@ class DFA {
         DFA(std::vector<char> alphabet, std::map<int, StateInfo> states, transition_table<int> table);
         void optimize();
         void normalize();
+        void reorderStates();
+        void reorderStates(const std::vector<std::string>& samples);
         std::pair<bool, int> match(std::string str);
         bool isMatch(std::string str);
         int transition(int s, char c);
         void mergeStates();
         void pruneStates();
         bool isAccepting(int s);
+        int stateCount();
+
+        dfa_prefilter prefilter();
+        bool isLiteral(std::string& literal);
+        int longestMatch(std::string_view text, int pos);
+        std::vector<std::pair<size_t, size_t>> findAll(std::string_view text);
         
         // I'm not a huge fan of the output format since it doesn't include alphabet info
         // This should only be used as an output function
@@ -45,4 +67,5 @@ class DFA {
         static DFA readTableFromAssignmentOutput(std::string tablePath, std::vector<char> alphabet);
 
         friend std::ostream& operator<<(std::ostream& os, const DFA& table);
+        friend class DFASearch;
 };
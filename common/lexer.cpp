@@ -1,121 +1,311 @@
 #include "lexer.h"
+#include "tokenfile.h"
+#include "trace.h"
 #include <sstream>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
 
-token create_token(std::string type, std::string value, int line, int pos) {
+token create_token(std::string type, std::string value, int offset) {
     token t;
     t.type = type;
     t.value = value;
-    t.line = line;
-    t.pos = pos;
+    t.offset = offset;
     return t;
 }
 
+int TokenSource::skip(int count) {
+    int skipped = 0;
+    while (skipped < count && next() != nullptr) skipped++;
+    return skipped;
+}
+
+VectorTokenSource::VectorTokenSource(const std::vector<token>& tokens) : tokens(tokens) {
+}
+
+const token* VectorTokenSource::next() {
+    if (pos >= tokens.size()) return nullptr;
+    return &tokens[pos++];
+}
+
+int VectorTokenSource::skip(int count) {
+    int skipped = std::min(count, (int)tokens.size() - pos);
+    pos += skipped;
+    return skipped;
+}
+
+token_definitions readTokenDefinitions(std::string path) {
+    std::ifstream defFile(path);
+    if (!defFile.good()) {
+        std::cerr << "ERROR: cannot access token definition at \"" << path << "\"" << std::endl;
+        throw 1;
+    }
+
+    std::string alphabetDef;
+    getline(defFile, alphabetDef);
+
+    std::vector<char> alphabet;
+    for (int i=0; i<alphabetDef.size(); i++) {
+        char c = alphabetDef.at(i);
+        if (c == ' ') continue;
+        if (c == 'x') {
+            char d2 = alphabetDef.at(i+1);
+            char d1 = alphabetDef.at(i+2);
+            i+=2;
+
+            int x;   
+            std::stringstream ss;
+            ss << std::hex << d2 << d1;
+            ss >> x;
+
+            alphabet.push_back((char)x);
+        }
+        else {
+            alphabet.push_back(c);
+        }
+    }
+
+    std::vector<token_table> tables;
+    std::string line;
+    while (std::getline(defFile, line))
+    {
+        std::istringstream iss(line);
+        
+        std::string tableFile;
+        std::string tokenName;
+        std::string tokenData;
+        iss >> tableFile;
+        iss >> tokenName;
+        iss >> tokenData;
+        if(tableFile.size() == 0 || tokenName.size() == 0) continue;
+
+        token_table tab;
+        tab.path = tableFile;
+        tab.token = tokenName;
+        tab.data = readHexASCII(tokenData);
+        tables.push_back(tab);
+    }
+
+    defFile.close();
+
+    token_definitions def;
+    def.alphabet = alphabet;
+    def.tables = tables;
+    return def;
+}
+
+Lexer Lexer::fromDefinitions(const token_definitions& def) {
+    std::vector<DFA> dfas;
+    std::vector<std::string> tokens;
+    std::vector<std::string> tokenData;
+    for (const token_table& tab : def.tables) {
+        DFA dfa = DFA::readTableFromAssignmentOutput(tab.path, def.alphabet);
+        dfas.push_back(dfa);
+        tokens.push_back(tab.token);
+        tokenData.push_back(tab.data);
+    }
+    return Lexer(def.alphabet, dfas, tokens, tokenData);
+}
+
 Lexer::Lexer(std::vector<char> alphabet, std::vector<DFA> dfas, std::vector<std::string> tokens, std::vector<std::string> tokenData) {
     this->alphabet = alphabet;
     std::unordered_set<char> alphabetSet(alphabet.begin(), alphabet.end());
     this->alphabetSet = alphabetSet;
-    this->dfas = dfas;
     this->tokens = tokens;
     this->tokenData = tokenData;
+
+    for (int i=0; i<dfas.size(); i++) {
+        std::string literal;
+        if (dfas[i].isLiteral(literal)) {
+            addLiteral(literal, i);
+        }
+        else {
+            this->dfas.push_back(dfas[i]);
+            this->dfaTokens.push_back(i);
+        }
+    }
+    this->dfaStates.resize(this->dfas.size(), 0);
 }
 
-std::vector<token> Lexer::tokenize(const std::string& inputStr) {
-    std::vector<token> tokenStream;
-    std::vector<int> dfaStates(dfas.size(), 0);
-    std::unordered_set<int> inactiveDfas;
-    std::map<int, int> matchedDfaEnds;
-
-    // line counting variables
-    int lineNum = 1;
-    int linePos = 0;
-    int startPos = 0;
-    int pos = 0;
-    while (pos < inputStr.length()) {
-        while (inactiveDfas.size() < dfas.size() && pos < inputStr.length()) {
-            char currentChar = inputStr.at(pos);
+void Lexer::addLiteral(const std::string& literal, int tokenIndex) {
+    if (trieTable.empty()) {
+        trieTable.resize(256, -1);
+        trieTokens.push_back(-1);
+    }
+
+    int node = 0;
+    for (char c : literal) {
+        int& next = trieTable[node * 256 + (unsigned char)c];
+        if (next == -1) {
+            next = trieTokens.size();
+            trieTokens.push_back(-1);
+            trieTable.resize(trieTable.size() + 256, -1);
+        }
+        node = trieTable[node * 256 + (unsigned char)c];
+    }
 
-            if (alphabetSet.find(currentChar) == alphabetSet.end()) {
-                std::cerr << "ERROR: character '" << currentChar << "' is not in the parse alphabet" << std::endl;
-                throw 1;
+    // for duplicate literals the earlier token keeps precedence
+    if (trieTokens[node] == -1) trieTokens[node] = tokenIndex;
+}
+
+// scans the longest token starting at pos and advances pos past it
+token Lexer::nextToken(const std::string& inputStr, int& pos) {
+    std::fill(dfaStates.begin(), dfaStates.end(), 0);
+    inactiveDfas.clear();
+    matchedDfaEnds.clear();
+    int trieState = trieTable.empty() ? -1 : 0;
+
+    int startPos = pos;
+    while ((inactiveDfas.size() < dfas.size() || trieState != -1) && pos < inputStr.length()) {
+        char currentChar = inputStr.at(pos);
+
+        if (alphabetSet.find(currentChar) == alphabetSet.end()) {
+            std::cerr << "ERROR: character '" << currentChar << "' is not in the parse alphabet" << std::endl;
+            throw 1;
+        }
+        for (int i=0; i<dfas.size(); i++) {
+            if (inactiveDfas.find(i) != inactiveDfas.end()) continue;
+
+            int currentState = dfaStates[i];
+            int nextState = dfas[i].transition(currentState, currentChar);
+
+            if (nextState == -1) {
+                inactiveDfas.insert(i);
             }
-            for (int i=0; i<dfas.size(); i++) {
-                if (inactiveDfas.find(i) != inactiveDfas.end()) continue;
-                
-                int currentState = dfaStates[i];
-                int nextState = dfas[i].transition(currentState, currentChar);
-                
-                if (nextState == -1) {
-                    inactiveDfas.insert(i);
-                }
 
-                if (dfas[i].isAccepting(currentState)) {
-                    matchedDfaEnds[i] = pos;
-                }
+            if (dfas[i].isAccepting(currentState)) {
+                matchedDfaEnds[dfaTokens[i]] = pos;
+            }
 
-                dfaStates[i] = nextState;
+            dfaStates[i] = nextState;
+        }
+        if (trieState != -1) {
+            if (trieTokens[trieState] != -1) {
+                matchedDfaEnds[trieTokens[trieState]] = pos;
             }
-            pos++;
-
-            // if end is reached, check for accepting tokens
-            if(pos == inputStr.length()) {
-                for (int i=0; i<dfas.size(); i++) {
-                    if (dfas[i].isAccepting(dfaStates[i])) {
-                        matchedDfaEnds[i] = pos;
-                    }
+            trieState = trieTable[trieState * 256 + (unsigned char)currentChar];
+        }
+        pos++;
+
+        // if end is reached, check for accepting tokens
+        if(pos == inputStr.length()) {
+            for (int i=0; i<dfas.size(); i++) {
+                if (dfas[i].isAccepting(dfaStates[i])) {
+                    matchedDfaEnds[dfaTokens[i]] = pos;
                 }
             }
+            if (trieState != -1 && trieTokens[trieState] != -1) {
+                matchedDfaEnds[trieTokens[trieState]] = pos;
+            }
         }
+    }
+    int extent = pos;
 
-        int maxEnd = 0, maxToken = 0;
-        for(std::pair<int, int> dfaEnds : matchedDfaEnds) {
-            // second disjunction condition checks for equal-length tokens, and gives precedence to 
-            // those which occur earlier in the definition file
-            if (dfaEnds.second > maxEnd || (dfaEnds.second == maxEnd && dfaEnds.first < maxToken)) {
-                maxToken = dfaEnds.first;
-                maxEnd = dfaEnds.second;
-            }
+    int maxEnd = -1, maxToken = 0;
+    for(std::pair<int, int> dfaEnds : matchedDfaEnds) {
+        // second disjunction condition checks for equal-length tokens, and gives precedence to 
+        // those which occur earlier in the definition file
+        if (dfaEnds.second > maxEnd || (dfaEnds.second == maxEnd && dfaEnds.first < maxToken)) {
+            maxToken = dfaEnds.first;
+            maxEnd = dfaEnds.second;
         }
+    }
 
-        matchedDfaEnds.clear();
-        inactiveDfas.clear();
-        std::fill(dfaStates.begin(), dfaStates.end(), 0);
+    // an empty match would never advance
+    if (maxEnd <= startPos) {
+        LineIndex lines(inputStr);
+        std::cerr << "ERROR: no token matches the input at line " << lines.line(startPos) << " position " << lines.column(startPos) << std::endl;
+        throw 1;
+    }
 
-        token tok;
-        tok.line = lineNum;
-        tok.pos = linePos + 1;
-        tok.type = tokens[maxToken];
+    token tok;
+    tok.offset = startPos;
+    tok.extent = extent;
+    tok.type = tokens[maxToken];
 
-        std::string altTokValue = tokenData[maxToken];
-        if (altTokValue.length() == 0) {
-            tok.value = inputStr.substr(startPos, maxEnd - startPos);
-        }
-        else {
-            tok.value = altTokValue;
-        }
-        
+    std::string altTokValue = tokenData[maxToken];
+    if (altTokValue.length() == 0) {
+        tok.value = inputStr.substr(startPos, maxEnd - startPos);
+    }
+    else {
+        tok.value = altTokValue;
+    }
 
-        // update lineNum and linePos
-        for (int i=startPos; i<maxEnd; i++) {
-            char c = inputStr.at(i);
-            linePos++;
-            if (c == '\n') {
-                lineNum++;
-                linePos = 0;
-            }
-        }
+    pos = maxEnd;
+    return tok;
+}
 
-        pos = maxEnd;
-        startPos = pos;
-        
-        tokenStream.push_back(tok);
+std::vector<token> Lexer::tokenize(const std::string& inputStr) {
+    TRACE_SCOPE("Lexer::tokenize");
+    std::vector<token> tokenStream;
+
+    int pos = 0;
+    while (pos < inputStr.length()) {
+        tokenStream.push_back(nextToken(inputStr, pos));
+    }
+
+    return tokenStream;
+}
+
+// relexes inputStr after deletedLength characters at editOffset were replaced by insertedLength
+// new ones. Scanning restarts at the first token whose scan reached the edit and stops as soon
+// as a token boundary past the edit lines up with one in previous, whose remaining tokens are
+// then shifted into place
+std::vector<token> Lexer::retokenize(const std::vector<token>& previous, const std::string& inputStr, int editOffset, int deletedLength, int insertedLength) {
+    if (previous.empty()) return tokenize(inputStr);
+    int shift = insertedLength - deletedLength;
+    int editEnd = editOffset + insertedLength;
+
+    // extent is where a token's scan stopped reading, so earlier tokens never saw the edit
+    int first = 0;
+    while (first < previous.size() - 1 && previous[first].extent < editOffset) first++;
+    std::vector<token> tokenStream(previous.begin(), previous.begin() + first);
+
+    int pos = previous[first].offset;
+    int next = first;
+    while (pos < inputStr.length()) {
+        tokenStream.push_back(nextToken(inputStr, pos));
+        if (pos < editEnd) continue;
+
+        int oldPos = pos - shift;
+        while (next < previous.size() && previous[next].offset < oldPos) next++;
+        if (next == previous.size() || previous[next].offset != oldPos) continue;
+
+        // resynchronized: the rest of previous only ever read text behind the edit
+        for (int i=next; i<previous.size(); i++) {
+            token tok = previous[i];
+            tok.offset += shift;
+            tok.extent += shift;
+            tokenStream.push_back(tok);
+        }
+        break;
     }
 
     return tokenStream;
 }
 
+LexerStream::LexerStream(Lexer& lexer, const std::string& inputStr) : lexer(lexer), inputStr(inputStr) {
+}
+
+// tokens of a skipped type (e.g. whitespace) are scanned but never handed out
+void LexerStream::skipType(std::string type) {
+    skippedTypes.insert(type);
+}
+
+// the token count is sampled into the trace every 1024 tokens, on whichever thread is lexing
+const token* LexerStream::next() {
+    while (pos < inputStr.length()) {
+        current = lexer.nextToken(inputStr, pos);
+        if (++scanned % 1024 == 0) TRACE_COUNTER("LexerStream tokens", scanned);
+        if (skippedTypes.find(current.type) == skippedTypes.end()) return &current;
+    }
+    TRACE_COUNTER("LexerStream tokens", scanned);
+    return nullptr;
+}
+
 std::string _cleanSrcFormat(std::string val) {
     std::stringstream ss;
     for (int i=0; i<val.length(); i++) {
@@ -130,10 +320,81 @@ std::string _cleanSrcFormat(std::string val) {
     return ss.str();
 }
 
-void printTokenStream(std::ostream& stream, const std::vector<token>& tokenStream) {
-    for (int i=0; i<tokenStream.size(); i++) {
-        token tok = tokenStream[i];
-        stream << tok.type << " " << _cleanSrcFormat(tok.value) << " " << tok.line << " " << tok.pos << std::endl;
+// what _cleanSrcFormat writes for every byte, so tokens can be escaped without a stringstream
+struct _escape {
+    int length;
+    char text[10];
+};
+
+const std::vector<_escape>& _escapeTable() {
+    static std::vector<_escape> table = []() {
+        std::vector<_escape> t(256);
+        for (int b = 0; b < 256; b++) {
+            std::string clean = _cleanSrcFormat(std::string(1, (char)b));
+            t[b].length = clean.size();
+            memcpy(t[b].text, clean.data(), clean.size());
+        }
+        return t;
+    }();
+    return table;
+}
+
+void appendCleanSrcFormat(std::string& out, std::string_view val) {
+    const std::vector<_escape>& escapes = _escapeTable();
+    for (char c : val) {
+        const _escape& e = escapes[(unsigned char)c];
+        out.append(e.text, e.length);
+    }
+}
+
+TokenWriter::TokenWriter(std::ostream& stream, int capacity) : stream(stream) {
+    buffer.resize(capacity);
+}
+
+TokenWriter::~TokenWriter() {
+    flush();
+}
+
+void TokenWriter::flush() {
+    if (used > 0) stream.write(buffer.data(), used);
+    used = 0;
+}
+
+// makes room for length more characters, growing the buffer for tokens that don't fit at all
+void TokenWriter::reserve(int length) {
+    if (used + length <= buffer.size()) return;
+    flush();
+    if (length > buffer.size()) buffer.resize(length);
+}
+
+void TokenWriter::write(const token& tok, LineIndex& lines) {
+    const std::vector<_escape>& escapes = _escapeTable();
+
+    // escapes are at most 9 characters, two ints at most 11 each, plus separators
+    reserve(tok.type.size() + tok.value.size() * 9 + 26);
+    char* out = buffer.data() + used;
+
+    memcpy(out, tok.type.data(), tok.type.size());
+    out += tok.type.size();
+    *out++ = ' ';
+    for (char c : tok.value) {
+        const _escape& e = escapes[(unsigned char)c];
+        memcpy(out, e.text, e.length);
+        out += e.length;
+    }
+    *out++ = ' ';
+    out = std::to_chars(out, out + 11, lines.line(tok.offset)).ptr;
+    *out++ = ' ';
+    out = std::to_chars(out, out + 11, lines.column(tok.offset)).ptr;
+    *out++ = '\n';
+
+    used = out - buffer.data();
+}
+
+void printTokenStream(std::ostream& stream, const std::vector<token>& tokenStream, LineIndex& lines) {
+    TokenWriter writer(stream);
+    for (const token& tok : tokenStream) {
+        writer.write(tok, lines);
     }
 }
 
@@ -185,10 +446,20 @@ std::string writeHexASCII(std::string str) {
 }
 
 
-std::vector<token> readTokenFile(std::string path) {
-    std::ifstream tokenIn(path);
+std::vector<token> readTokenFile(std::string path, const std::unordered_set<std::string>& skippedTypes) {
     std::vector<token> tokenOut;
 
+    // binary files hold raw values, which are escaped the way the text format stores them
+    if (isBinaryTokenFile(path)) {
+        TokenFileView view(path);
+        TokenFileSource source(view, skippedTypes);
+        tokenOut.reserve(view.size());
+        while (const token* tok = source.next()) tokenOut.push_back(*tok);
+        return tokenOut;
+    }
+
+    std::ifstream tokenIn(path);
+
     std::string line;
     while (std::getline(tokenIn, line)) {
         std::string type, value;
@@ -197,10 +468,12 @@ std::vector<token> readTokenFile(std::string path) {
         if (iss.rdbuf()->in_avail() == 0) continue;
         iss >> type;
         if (iss.rdbuf()->in_avail() != 0) iss >> value;
+        if (skippedTypes.find(type) != skippedTypes.end()) continue;
 
         token t;
         t.type = type;
         t.value = value;
+        if (!(iss >> t.line >> t.col)) t.line = t.col = 0;
         tokenOut.push_back(t);
     }
     
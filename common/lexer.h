@@ -1,32 +1,119 @@
 #pragma once
 
 #include <vector>
+#include <string_view>
 #include <unordered_set>
 #include "dfa.h"
+#include "lines.h"
 
+// line and column aren't stored, a LineIndex over the scanned input derives them from offset
 struct token {
     std::string type;
     std::string value;
-    int line;
-    int pos;
+    int offset = 0;   // start of the token in the scanned input
+    int extent = 0;   // one past the last character read while scanning it
+    int line = 0;     // position read back from a token file, 0 when unknown
+    int col = 0;
 };
 
-token create_token(std::string type, std::string value, int line, int pos);
+token create_token(std::string type, std::string value, int offset);
+
+// anything the parser can pull tokens from one at a time. A returned token stays valid until
+// the next call, and nullptr marks the end of the stream
+class TokenSource {
+    public:
+        virtual ~TokenSource() {}
+        virtual const token* next() = 0;
+        virtual int skip(int count);
+};
+
+// hands out the tokens of a vector in order without copying them
+class VectorTokenSource : public TokenSource {
+    private:
+        const std::vector<token>& tokens;
+        int pos = 0;
+    public:
+        VectorTokenSource(const std::vector<token>& tokens);
+        const token* next() override;
+        int skip(int count) override;
+};
+
+// a scanner definition file (scan.u): the alphabet, then one line per token with its table
+// file, name and optional replacement value
+struct token_table {
+    std::string path;
+    std::string token;
+    std::string data;  // defaults to empty string if data should be matched token
+};
+
+struct token_definitions {
+    std::vector<char> alphabet;
+    std::vector<token_table> tables;
+};
+
+token_definitions readTokenDefinitions(std::string path);
 
 class Lexer {
     private:
         std::vector<char> alphabet;
         std::unordered_set<char> alphabetSet;
         std::vector<DFA> dfas;
+        std::vector<int> dfaTokens;
         std::vector<std::string> tokens;
         std::vector<std::string> tokenData;
+
+        // tokens whose DFA accepts a single literal (keywords, operators) share one trie that
+        // is stepped in lockstep with the remaining DFAs
+        std::vector<int> trieTable;
+        std::vector<int> trieTokens;
+        void addLiteral(const std::string& literal, int tokenIndex);
+
+        // scratch reused by every scan
+        std::vector<int> dfaStates;
+        std::unordered_set<int> inactiveDfas;
+        std::map<int, int> matchedDfaEnds;
     public:
         Lexer(std::vector<char> alphabet, std::vector<DFA> dfas, std::vector<std::string> tokens, std::vector<std::string> tokenData);
+        static Lexer fromDefinitions(const token_definitions& def);
+        token nextToken(const std::string& inputStr, int& pos);
         std::vector<token> tokenize(const std::string& inputStr);
+        std::vector<token> retokenize(const std::vector<token>& previous, const std::string& inputStr, int editOffset, int deletedLength, int insertedLength);
+};
+
+// formats token lines into a large buffer that's handed to the stream with one write per fill
+class TokenWriter {
+    private:
+        std::ostream& stream;
+        std::vector<char> buffer;
+        int used = 0;
+        void reserve(int length);
+
+    public:
+        TokenWriter(std::ostream& stream, int capacity = 1 << 16);
+        ~TokenWriter();
+        void write(const token& tok, LineIndex& lines);
+        void flush();
+};
+
+// scans tokens only as a consumer pulls them, so the whole token stream never exists at once
+class LexerStream : public TokenSource {
+    private:
+        Lexer& lexer;
+        const std::string& inputStr;
+        int pos = 0;
+        int scanned = 0;  // tokens read so far, skipped ones included
+        token current;
+        std::unordered_set<std::string> skippedTypes;
+    public:
+        LexerStream(Lexer& lexer, const std::string& inputStr);
+        void skipType(std::string type);
+        const token* next() override;
 };
 
-void printTokenStream(std::ostream& stream, const std::vector<token>& tokenStream);
-std::vector<token> readTokenFile(std::string path);
+void printTokenStream(std::ostream& stream, const std::vector<token>& tokenStream, LineIndex& lines);
+std::string _cleanSrcFormat(std::string val);  // how token files escape values
+void appendCleanSrcFormat(std::string& out, std::string_view val);  // same escaping, table driven
+std::vector<token> readTokenFile(std::string path, const std::unordered_set<std::string>& skippedTypes = {});
 std::string readHexASCII(std::string str);
 std::string writeHexASCII(std::string str);
 std::string charToHex(char c);
@@ -0,0 +1,37 @@
+#include <cstring>
+#include <algorithm>
+#include "lines.h"
+
+LineIndex::LineIndex(std::string_view text) {
+    this->text = text;
+}
+
+void LineIndex::build() {
+    // memchr is vectorized by the C library, so this only touches newlines one at a time
+    const char* start = text.data();
+    const char* end = start + text.size();
+    const char* pos = start;
+    while (pos < end) {
+        const void* found = memchr(pos, '\n', end - pos);
+        if (found == nullptr) break;
+        newlines.push_back((const char*)found - start);
+        pos = (const char*)found + 1;
+    }
+    built = true;
+}
+
+// lines and columns count from 1, and a newline belongs to the line it ends
+int LineIndex::line(int offset) {
+    if (!built) build();
+    return std::lower_bound(newlines.begin(), newlines.end(), offset) - newlines.begin() + 1;
+}
+int LineIndex::column(int offset) {
+    if (!built) build();
+    auto itr = std::lower_bound(newlines.begin(), newlines.end(), offset);
+    int lineStart = itr == newlines.begin() ? 0 : *(itr - 1) + 1;
+    return offset - lineStart + 1;
+}
+int LineIndex::lineCount() {
+    if (!built) build();
+    return newlines.size() + 1;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+// line and column lookup for offsets into a buffer. The newline positions are found with one
+// memchr sweep the first time they're needed, after which each lookup is a binary search
+class LineIndex {
+    private:
+        std::string_view text;
+        bool built = false;
+        std::vector<int> newlines;
+        void build();
+
+    public:
+        LineIndex(std::string_view text);
+        int line(int offset);
+        int column(int offset);
+        int lineCount();
+};
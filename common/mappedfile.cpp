@@ -0,0 +1,37 @@
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mappedfile.h"
+
+MappedFile::MappedFile(std::string path, std::string what) {
+    fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        std::cerr << "ERROR: could not access " << what << " \"" << path << "\"" << std::endl;
+        if (fd != -1) close(fd);
+        throw 1;
+    }
+
+    // empty files can't be mapped, they're just an empty view
+    length = info.st_size;
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "ERROR: could not map " << what << " \"" << path << "\"" << std::endl;
+            close(fd);
+            throw 1;
+        }
+        data = (const char*)mapped;
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) munmap((void*)data, length);
+    close(fd);
+}
+
+std::string_view MappedFile::view() {
+    return std::string_view(data, length);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// a whole file mapped read-only into memory, so large inputs are paged in by the kernel as
+// they're scanned instead of being copied into a string first
+class MappedFile {
+    private:
+        int fd = -1;
+        const char* data = nullptr;
+        size_t length = 0;
+
+    public:
+        // what names the file in the error message if it can't be opened or mapped
+        MappedFile(std::string path, std::string what);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        std::string_view view();
+};
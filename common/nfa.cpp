@@ -4,10 +4,13 @@
 #include <vector>
 #include <unordered_set>
 #include <set>
+#include <charconv>
+#include <algorithm>
 
 #include "nfa.h"
 #include "dfa.h"
 #include "lexer.h"
+#include "trace.h"
 
 bool isEmpty(std::ifstream& pFile)
 {
@@ -154,28 +157,65 @@ void NFA::_constructFromDefinition(Definition def) {
             stateInfo.start = line.from == 0;
             this->states[line.from] = stateInfo;
         }
-        // add to adjacency
+        // add to adjacency, all of the line's characters form a single edge
+        Transition t;
+        t.to = line.to;
         for(char transitionChar : line.transitionCharacters) {
-            Transition t;
-            t.to = line.to;
-            t.token = transitionChar;
-            this->adjacency[line.from].push_back(t);
+            if (transitionChar == this->lambda) {
+                this->lambdaAdjacency[line.from].push_back(line.to);
+                this->hasLambdas = true;
+            }
+            else {
+                t.chars.set((unsigned char)transitionChar);
+            }
         }
+        if (t.chars.any()) this->adjacency[line.from].push_back(t);
     }
 }
 
-std::vector<Transition> NFA::lambdaTransitions(int s) {
-    return this->charTransitions(s, this->lambda);
+std::vector<int>& NFA::lambdaTransitions(int s) {
+    return this->lambdaAdjacency[s];
+}
+
+std::vector<Transition>& NFA::classTransitions(int s) {
+    return this->adjacency[s];
 }
 
 std::vector<Transition> NFA::charTransitions(int s, char c) {
-    std::vector<Transition> all = this->adjacency[s];
-    std::vector<Transition> lambda;
-    for (Transition t : all) {
-        if (t.token == c)
-            lambda.push_back(t);
+    std::vector<Transition> matching;
+    for (Transition& t : this->adjacency[s]) {
+        if (t.chars.test((unsigned char)c))
+            matching.push_back(t);
     }
-    return lambda;
+    return matching;
+}
+
+// splits the alphabet into blocks of characters that no edge label tells apart. Every character
+// in a block leads to the same subset, so subset construction only has to follow one per block
+std::vector<char_class> NFA::alphabetPartition() {
+    char_class alphabetChars;
+    for (char c : this->alphabet) alphabetChars.set((unsigned char)c);
+
+    std::unordered_set<char_class> labels;
+    for (auto& row : this->adjacency) {
+        for (Transition& t : row.second) {
+            labels.insert(t.chars & alphabetChars);
+        }
+    }
+
+    std::vector<char_class> blocks;
+    if (alphabetChars.any()) blocks.push_back(alphabetChars);
+    for (const char_class& label : labels) {
+        std::vector<char_class> refined;
+        for (char_class& block : blocks) {
+            char_class inside = block & label;
+            char_class outside = block & ~label;
+            if (inside.any()) refined.push_back(inside);
+            if (outside.any()) refined.push_back(outside);
+        }
+        blocks.swap(refined);
+    }
+    return blocks;
 }
 
 state_set followLambda(NFA* nfa, state_set S) {
@@ -188,30 +228,54 @@ state_set followLambda(NFA* nfa, state_set S) {
         int t = frontier.back();
         frontier.pop_back();
 
-        for(Transition tr : nfa->lambdaTransitions(t)) {
+        for(int to : nfa->lambdaTransitions(t)) {
             // if frontier doesn't have state already in it
-            if(S.find(tr.to) == S.end()) {
-                S.insert(tr.to);
-                frontier.push_back(tr.to);
+            if(S.find(to) == S.end()) {
+                S.insert(to);
+                frontier.push_back(to);
             }
         }
     }
     return S;
 }
 
-state_set followChar(NFA* nfa, state_set S, char c) {
+state_set followChar(NFA* nfa, const state_set& S, char c) {
     state_set frontier;
     for(int state : S) {
-        for(Transition t : nfa->charTransitions(state, c)) {
-            frontier.insert(t.to);
+        for(Transition& t : nfa->classTransitions(state)) {
+            if (t.chars.test((unsigned char)c)) frontier.insert(t.to);
         }
     }
     return frontier;
 }
 
-DFA NFA::toDFA() {
+bool parseLimit(const std::string& value, size_t& limit) {
+    const char* end = value.data() + value.size();
+    std::from_chars_result result = std::from_chars(value.data(), end, limit);
+    return !value.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// rough heap footprint of one copy of a subset state: the set plus a tree node per member
+size_t _stateSetBytes(const state_set& s) {
+    return sizeof(state_set) + s.size() * (sizeof(int) + 4 * sizeof(void*));
+}
+
+void _checkLimits(const dfa_limits& limits, size_t states, size_t bytes) {
+    if (limits.maxStates > 0 && states > limits.maxStates) {
+        std::cerr << "ERROR: subset construction exceeded the limit of " << limits.maxStates << " DFA states" << std::endl;
+        throw 4;
+    }
+    if (limits.maxBytes > 0 && bytes > limits.maxBytes) {
+        std::cerr << "ERROR: subset construction exceeded the limit of " << limits.maxBytes << " bytes" << std::endl;
+        throw 4;
+    }
+}
+
+DFA NFA::toDFA(const dfa_limits& limits) {
+    TRACE_SCOPE("NFA::toDFA");
     transition_table<state_set> transitionTable;
     std::map<state_set, StateInfo> stateInfo;
+    size_t bytes = 0;
 
     std::vector<state_set> L;
 
@@ -224,25 +288,39 @@ DFA NFA::toDFA() {
         if(i.accepting) acceptingStates.insert(s.first);
     }
     
-    // merge starting states
-    state_set dfaStarting = followLambda(this, startingStates);
+    // merge starting states. lambda-free NFAs (e.g. position automata) skip closure entirely
+    state_set dfaStarting = hasLambdas ? followLambda(this, startingStates) : startingStates;
 
     StateInfo dfaStartingInfo;
     dfaStartingInfo.start = true;
     state_set startingAccepting = stateIntersect(dfaStarting, acceptingStates);
     dfaStartingInfo.accepting = startingAccepting.size() > 0;
     stateInfo[dfaStarting] = dfaStartingInfo;
+    bytes += _stateSetBytes(dfaStarting);
+    _checkLimits(limits, stateInfo.size(), bytes);
 
     L.push_back(dfaStarting);
 
+    std::vector<char_class> partition = alphabetPartition();
+
     // iterate over table
     while (L.size() > 0) {
         state_set currentState = L.back();
         L.pop_back();
 
-        for (char currentChar : this->alphabet) {
-            state_set R = followLambda(this, followChar(this, currentState, currentChar));
-            transitionTable[currentState][currentChar] = R;
+        for (char_class& block : partition) {
+            char representative = 0;
+            while (!block.test((unsigned char)representative)) representative++;
+
+            state_set R = followChar(this, currentState, representative);
+            if (hasLambdas) R = followLambda(this, R);
+            std::map<char, state_set>& tableRow = transitionTable[currentState];
+            for (char currentChar : this->alphabet) {
+                if (block.test((unsigned char)currentChar)) {
+                    tableRow[currentChar] = R;
+                    bytes += _stateSetBytes(R) + 4 * sizeof(void*);
+                }
+            }
             if(R.size() > 0 && stateInfo.count(R) == 0) {
                 // assign info about R
                 StateInfo Rinfo;
@@ -250,6 +328,8 @@ DFA NFA::toDFA() {
                 state_set Raccepting = stateIntersect(R, acceptingStates);
                 Rinfo.accepting = Raccepting.size() > 0;
                 stateInfo[R] = Rinfo;
+                bytes += _stateSetBytes(R) + 4 * sizeof(void*);
+                _checkLimits(limits, stateInfo.size(), bytes);
 
                 // push onto stack to process it
                 L.push_back(R);
@@ -286,10 +366,173 @@ DFA NFA::toDFA() {
     return dfa;
 }
 
+state_set NFA::startSet() {
+    state_set start;
+    for (std::pair<const int, StateInfo>& s : this->states) {
+        if (s.second.start) start.insert(s.first);
+    }
+    return hasLambdas ? followLambda(this, start) : start;
+}
+
+state_set NFA::step(const state_set& current, char c) {
+    state_set next = followChar(this, current, c);
+    return hasLambdas ? followLambda(this, next) : next;
+}
+
+bool NFA::isAccepting(const state_set& current) {
+    for (int s : current) {
+        if (this->states[s].accepting) return true;
+    }
+    return false;
+}
+
+// mirrors DFA::match, including its return positions
+std::pair<bool, int> NFA::match(const std::string& str) {
+    state_set current = startSet();
+    for (int pos = 0; pos < str.length(); pos++) {
+        current = step(current, str[pos]);
+        if (current.empty()) return std::make_pair(false, pos + 1);
+    }
+
+    bool acc = isAccepting(current);
+    int accPos = str.length() + 1;
+    if (!acc && str.length() == 0) {
+        accPos = 0;
+    }
+    return std::make_pair(acc, accPos);
+}
+
+int NFA::longestMatch(std::string_view text, int pos) {
+    state_set current = startSet();
+    int end = isAccepting(current) ? pos : -1;
+    for (int i = pos; i < text.size(); i++) {
+        current = step(current, text[i]);
+        if (current.empty()) break;
+        if (isAccepting(current)) end = i + 1;
+    }
+    return end;
+}
+
+// live sets are replayed a block of this many positions at a time, see NFA::findAll
+const size_t NFA_SEARCH_BLOCK = 1 << 12;
+
+// leftmost-longest, non-overlapping spans in one pass over the text, the way DFASearch finds
+// them. A backward pass works out, for every position, the live states: those that can still
+// reach an accepting state reading on from there. The forward simulation starts a match wherever
+// the start set meets them and drops every state that isn't live, so a match ends as soon as it
+// can't be extended and nothing is read twice. Live sets are only stored at block boundaries
+std::vector<std::pair<size_t, size_t>> NFA::findAll(std::string_view text) {
+    size_t n = text.size();
+    int stateCount = 0;
+    for (std::pair<const int, StateInfo>& s : states) stateCount = std::max(stateCount, s.first + 1);
+    for (std::pair<const int, std::vector<Transition>>& edges : adjacency) {
+        for (Transition& t : edges.second) stateCount = std::max(stateCount, t.to + 1);
+    }
+    for (std::pair<const int, std::vector<int>>& edges : lambdaAdjacency) {
+        for (int to : edges.second) stateCount = std::max({stateCount, to + 1, edges.first + 1});
+    }
+
+    std::vector<bool> accepting(stateCount);
+    for (std::pair<const int, StateInfo>& s : states) accepting[s.first] = s.second.accepting;
+    std::vector<std::vector<int>> lambdaPredecessors(stateCount);
+    for (std::pair<const int, std::vector<int>>& edges : lambdaAdjacency) {
+        for (int to : edges.second) lambdaPredecessors[to].push_back(edges.first);
+    }
+
+    // the live set before reading c, given the live set after it
+    auto backStep = [&](const std::vector<bool>& after, char c) {
+        std::vector<bool> live = accepting;
+        for (std::pair<const int, std::vector<Transition>>& edges : adjacency) {
+            for (Transition& t : edges.second) {
+                if (after[t.to] && t.chars.test((unsigned char)c)) {
+                    live[edges.first] = true;
+                    break;
+                }
+            }
+        }
+        if (hasLambdas) {
+            std::vector<int> frontier;
+            for (int q = 0; q < stateCount; q++) if (live[q]) frontier.push_back(q);
+            while (!frontier.empty()) {
+                int r = frontier.back();
+                frontier.pop_back();
+                for (int q : lambdaPredecessors[r]) {
+                    if (live[q]) continue;
+                    live[q] = true;
+                    frontier.push_back(q);
+                }
+            }
+        }
+        return live;
+    };
+
+    // backward pass: checkpoints[b] is the live set at position min(b * NFA_SEARCH_BLOCK, n)
+    size_t blocks = n / NFA_SEARCH_BLOCK + 1;
+    // with nothing live after it, a step leaves just the states that accept right away
+    std::vector<bool> atEnd = backStep(std::vector<bool>(stateCount), '\0');
+    std::vector<std::vector<bool>> checkpoints(blocks + 1, atEnd);
+    std::vector<bool> live = atEnd;
+    for (size_t i = n; i > 0; i--) {
+        if (i % NFA_SEARCH_BLOCK == 0) checkpoints[i / NFA_SEARCH_BLOCK] = live;
+        live = backStep(live, text[i - 1]);
+    }
+    checkpoints[0] = live;
+
+    // a block is replayed from the checkpoint at its end once the forward pass reaches it, which
+    // only ever looks back one position, so two cached blocks are enough
+    std::vector<std::vector<bool>> cached[2];
+    size_t cachedBlock[2] = { blocks, blocks };
+    int older = 0;
+    auto liveAt = [&](size_t i) -> const std::vector<bool>& {
+        size_t b = i / NFA_SEARCH_BLOCK;
+        size_t first = b * NFA_SEARCH_BLOCK;
+        if (cachedBlock[0] == b) return cached[0][i - first];
+        if (cachedBlock[1] == b) return cached[1][i - first];
+
+        std::vector<std::vector<bool>>& sets = cached[older];
+        cachedBlock[older] = b;
+        older = 1 - older;
+        size_t last = std::min(first + NFA_SEARCH_BLOCK, n);
+        sets.resize(last - first + 1);
+        sets[last - first] = checkpoints[b + 1];
+        for (size_t j = last; j > first; j--) sets[j - 1 - first] = backStep(sets[j - first], text[j - 1]);
+        return sets[i - first];
+    };
+    auto keepLive = [&](const state_set& current, const std::vector<bool>& live) {
+        state_set kept;
+        for (int s : current) if (live[s]) kept.insert(s);
+        return kept;
+    };
+
+    std::vector<std::pair<size_t, size_t>> spans;
+    state_set start = startSet();
+    size_t pos = 0;
+    while (pos <= n) {
+        state_set current = keepLive(start, liveAt(pos));
+        if (current.empty()) {
+            pos++;
+            continue;
+        }
+
+        size_t matchEnd = pos;
+        for (size_t i = pos; i < n; i++) {
+            current = keepLive(step(current, text[i]), liveAt(i + 1));
+            if (current.empty()) break;
+            if (isAccepting(current)) matchEnd = i + 1;
+        }
+        spans.push_back(std::make_pair(pos, matchEnd));
+        pos = matchEnd > pos ? matchEnd : pos + 1;
+    }
+    return spans;
+}
+
 
 
 void NFABuilder::addEdge(int src, int dst, char c) {
-    transitions[src][c] = dst;
+    transitions[src][dst].set((unsigned char)c);
+}
+void NFABuilder::addClassEdge(int src, int dst, const char_class& chars) {
+    transitions[src][dst] |= chars;
 }
 void NFABuilder::addLambda(int src, int dst) {
     lambdas[src].insert(dst);
@@ -306,6 +549,26 @@ void NFABuilder::setAcceptingState(int acceptingState) {
     this->acceptingState = acceptingState;
 }
 
+// formats a character class compactly, collapsing runs of 3+ characters into ranges (a-z)
+std::string charClassLabel(const char_class& chars) {
+    std::ostringstream oss;
+    int c = 0;
+    while (c < 256) {
+        if (!chars.test(c)) {
+            c++;
+            continue;
+        }
+        int end = c;
+        while (end + 1 < 256 && chars.test(end + 1)) end++;
+
+        oss << charToHexIfNecessary((char)c);
+        if (end - c >= 2) oss << "-" << charToHexIfNecessary((char)end);
+        else if (end > c) oss << charToHexIfNecessary((char)end);
+        c = end + 1;
+    }
+    return oss.str();
+}
+
 char _unusedCharacter(std::vector<char>& alphabet) {
     std::unordered_set<char> alphabetSet;
     for (char c : alphabet) alphabetSet.insert(c);
@@ -331,15 +594,16 @@ Definition NFABuilder::toDefinition(std::vector<char> alphabet) {
     Definition def;
     def.head = head;
 
-    // add transition edges
-    for (auto row: transitions) {
-        for (auto edge: row.second) {
-            char c = edge.first;
+    // add transition edges, one line per edge carrying its whole character class
+    for (auto& row: transitions) {
+        for (auto& edge: row.second) {
             DefinitionLine line;
-            line.accepting = false;
+            line.accepting = row.first == getAcceptingState();
             line.from = row.first;
-            line.to = edge.second;
-            line.transitionCharacters.push_back(c);
+            line.to = edge.first;
+            for (int c = 0; c < 256; c++) {
+                if (edge.second.test(c)) line.transitionCharacters.push_back((char)c);
+            }
             def.lines.push_back(line);
         }
     }
@@ -349,7 +613,7 @@ Definition NFABuilder::toDefinition(std::vector<char> alphabet) {
         int from = row.first;
         for (int to : row.second) {
             DefinitionLine line;
-            line.accepting = false;
+            line.accepting = from == getAcceptingState();
             line.from = from;
             line.to = to;
             line.transitionCharacters.push_back(head.lambda);
@@ -357,7 +621,8 @@ Definition NFABuilder::toDefinition(std::vector<char> alphabet) {
         }
     }
 
-    // add accepting node statement
+    // add accepting node statement. NFA takes a state's acceptance from its first line, so any
+    // edges leaving the accepting state above are marked accepting as well
     DefinitionLine acc;
     acc.accepting = true;
     acc.from = getAcceptingState();
@@ -384,11 +649,10 @@ std::string NFABuilder::toGraphviz() {
     oss << std::endl;
 
     // add transition edges
-    for (auto row : transitions) {
-        for (auto edge : row.second) {
-            char c = edge.first;
-            oss << row.first << " -> " << edge.second;
-            oss << " [label = \"" << charToHexIfNecessary(c) << "\"];" << std::endl;
+    for (auto& row : transitions) {
+        for (auto& edge : row.second) {
+            oss << row.first << " -> " << edge.first;
+            oss << " [label = \"" << charClassLabel(edge.second) << "\"];" << std::endl;
         }
     }
 
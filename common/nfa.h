@@ -24,6 +24,7 @@ struct Definition {
 };
 
 Definition readDefinition(std::string filePath, bool skipHead=false);
+char _unusedCharacter(std::vector<char>& alphabet);
 void writeDefinition(std::ostream& os, Definition& def);
 
 
@@ -33,25 +34,51 @@ std::ostream& operator<<(std::ostream& os, const Definition& def);
 
 
 
+std::string charClassLabel(const char_class& chars);
+
+// caps on subset construction, 0 meaning unlimited. toDFA throws 4 as soon as either is passed,
+// so callers can report it or fall back to simulating the NFA directly
+struct dfa_limits {
+    size_t maxStates = 0;
+    size_t maxBytes = 0;  // estimated heap used by the subset states and their transitions
+};
+
+// reads a --max-states/--max-bytes value, false unless it's a non-negative integer that fits
+bool parseLimit(const std::string& value, size_t& limit);
+
 class NFA {
     private:
+        // each definition line becomes at most one character class edge, lambdas are kept apart
         std::map<int, std::vector<Transition>> adjacency;
+        std::map<int, std::vector<int>> lambdaAdjacency;
         std::map<int, StateInfo> states;
         char lambda;
+        bool hasLambdas = false;
         std::vector<char> alphabet;
 
         void _constructFromDefinition(Definition def);
+        std::vector<char_class> alphabetPartition();
+        state_set startSet();
+        state_set step(const state_set& current, char c);
+        bool isAccepting(const state_set& current);
     public:
         NFA(Definition def);
-        DFA toDFA();
-        std::vector<Transition> lambdaTransitions(int s);
+        DFA toDFA(const dfa_limits& limits = dfa_limits());
+
+        // the same queries as DFA, answered by tracking the set of live NFA states, for automata
+        // whose DFA would be too large to build
+        std::pair<bool, int> match(const std::string& str);
+        int longestMatch(std::string_view text, int pos);
+        std::vector<std::pair<size_t, size_t>> findAll(std::string_view text);
+        std::vector<int>& lambdaTransitions(int s);
+        std::vector<Transition>& classTransitions(int s);
         std::vector<Transition> charTransitions(int s, char c);
 };
 
 class NFABuilder {
     private:
-        // (state, character) => state'
-        std::map<int, std::map<char, int>> transitions;
+        // (state, state') => characters
+        std::map<int, std::map<int, char_class>> transitions;
         // state => { lambda_states }
         std::map<int, std::unordered_set<int>> lambdas;
         int acceptingState = 0;
@@ -59,6 +86,7 @@ class NFABuilder {
     public:
         int addState();
         void addEdge(int src, int dst, char c);
+        void addClassEdge(int src, int dst, const char_class& chars);
         void addLambda(int src, int dst);
         int getAcceptingState();
         void setAcceptingState(int acceptingState);
@@ -1,7 +1,9 @@
 #include <sstream>
+#include <set>
 #include "regex.h"
 #include "cfg.h"
 #include "nfa.h"
+#include "stats.h"
 
 const char* _llreCfg = R"(
      RE -> ALT $
@@ -144,25 +146,219 @@ void _sdt_re(ParseTree &tree, int node, symbolmap smap) {
     tree.addChild(node, tree.getChildren(alt)->at(0));
 }
 
+const std::map<std::string, sdtcallback> _regexTranslations = {
+    { "NUCLEUS", &_sdt_nucleus },
+    { "ATOM",    &_sdt_atom },
+    { "SEQLIST", &_sdt_seqlist },
+    { "SEQ",     &_sdt_seqlist },
+    { "ALTLIST", &_sdt_altlist },
+    { "ALT",     &_sdt_alt },
+    { "RE",      &_sdt_re },
+};
+
+
+// single pass recursive descent parser for the _llre grammar. It reads the regex characters
+// directly and builds the same compact AST that the SDT callbacks above leave behind after
+// CFG::match, without ever materializing the concrete parse tree
+enum _retoken { RE_CHAR, RE_KLEENE, RE_PLUS, RE_PIPE, RE_DOT, RE_RANGE, RE_OPEN, RE_CLOSE, RE_END };
+const char* _retokenNames[] = { "char", "kleene", "plus", "pipe", "dot", "range", "open", "close", "$" };
+
+class _RegexParser {
+    private:
+        const std::string& regex;
+        ParseTree& tree;
+        int pos = 0;         // character position of the current token
+        int tokenPos = 0;    // token index of the current token, used for error reporting
+        _retoken type;
+        char value;
+        int width;
+
+        int reLabel, seqLabel, pipeLabel, kleeneLabel, plusLabel, charLabel, dotLabel, rangeLabel;
+
+        void scan();
+        void advance();
+        int addLeaf(int label);
+        void unexpected();
+
+        int parseAlt();
+        int parseSeq();
+        int parseAtom();
+        int parseNucleus();
+    public:
+        _RegexParser(const std::string& regex, ParseTree& tree);
+        int parse();
+};
+
+_RegexParser::_RegexParser(const std::string& regex, ParseTree& tree) : regex(regex), tree(tree) {
+    std::map<std::string, int> smap = _llre.getSymbolMap();
+    reLabel = smap["RE"];
+    seqLabel = smap["SEQ"];
+    pipeLabel = smap["pipe"];
+    kleeneLabel = smap["kleene"];
+    plusLabel = smap["plus"];
+    charLabel = smap["char"];
+    dotLabel = smap["dot"];
+    rangeLabel = smap["range"];
+}
+
+// decodes the token at pos, mirroring tokenizeRegex
+void _RegexParser::scan() {
+    if (pos >= regex.size()) {
+        type = RE_END;
+        width = 0;
+        return;
+    }
+
+    char c = regex.at(pos);
+    value = c;
+    width = 1;
+    if (c == '\\') {
+        // a trailing backslash escapes nothing and is dropped
+        if (pos + 1 >= regex.size()) {
+            type = RE_END;
+            return;
+        }
+        char e = regex.at(pos + 1);
+        if (e == 's') value = ' ';
+        else if (e == 'n') value = '\n';
+        else value = e;
+        type = RE_CHAR;
+        width = 2;
+        return;
+    }
+
+    switch (c) {
+        case '*': type = RE_KLEENE; break;
+        case '+': type = RE_PLUS; break;
+        case '|': type = RE_PIPE; break;
+        case '.': type = RE_DOT; break;
+        case '-': type = RE_RANGE; break;
+        case '(': type = RE_OPEN; break;
+        case ')': type = RE_CLOSE; break;
+        default: type = RE_CHAR; break;
+    }
+}
+
+void _RegexParser::advance() {
+    pos += width;
+    tokenPos++;
+    scan();
+}
+
+int _RegexParser::addLeaf(int label) {
+    tree_metadata meta;
+    meta.value.push_back(value);
+    return tree.addNode(label, meta);
+}
+
+void _RegexParser::unexpected() {
+    std::cerr << "ERROR: unexpected token \'" << _retokenNames[type] << "\' in position " << tokenPos << std::endl;
+    throw 2;
+}
+
+int _RegexParser::parse() {
+    scan();
+    int re = tree.addNode(reLabel, EMPTY_METADATA);
+    tree.addChild(re, parseAlt());
+    if (type != RE_END) unexpected();
+    tree.setRoot(re);
+    return re;
+}
+
+int _RegexParser::parseAlt() {
+    int seq = parseSeq();
+    if (type != RE_PIPE) return seq;
+
+    int pipe = addLeaf(pipeLabel);
+    tree.addChild(pipe, seq);
+    while (type == RE_PIPE) {
+        advance();
+        tree.addChild(pipe, parseSeq());
+    }
+    return pipe;
+}
+
+int _RegexParser::parseSeq() {
+    int seq = tree.addNode(seqLabel, EMPTY_METADATA);
+    while (type == RE_CHAR || type == RE_OPEN || type == RE_DOT) {
+        tree.addChild(seq, parseAtom());
+    }
+    // only the follow set of SEQ may end a sequence
+    if (type != RE_PIPE && type != RE_CLOSE && type != RE_END) unexpected();
+    return seq;
+}
+
+int _RegexParser::parseAtom() {
+    int nucleus = parseNucleus();
+    if (type != RE_KLEENE && type != RE_PLUS) return nucleus;
+
+    int mod = addLeaf(type == RE_KLEENE ? kleeneLabel : plusLabel);
+    tree.addChild(mod, nucleus);
+    advance();
+    return mod;
+}
+
+int _RegexParser::parseNucleus() {
+    if (type == RE_OPEN) {
+        advance();
+        int alt = parseAlt();
+        if (type != RE_CLOSE) unexpected();
+        advance();
+        return alt;
+    }
+    if (type == RE_DOT) {
+        int dot = addLeaf(dotLabel);
+        advance();
+        return dot;
+    }
+
+    int first = addLeaf(charLabel);
+    advance();
+    if (type != RE_RANGE) return first;
+
+    int range = addLeaf(rangeLabel);
+    advance();
+    if (type != RE_CHAR) unexpected();
+    int last = addLeaf(charLabel);
+    advance();
+    tree.addChild(range, first);
+    tree.addChild(range, last);
+    return range;
+}
+
+
+// a fresh session per call keeps this reentrant; callers parsing many regexes should keep a
+// session of their own and use the overload below
 ParseTree parseRegex(std::string regex) {
-    std::vector<token> regexTokens = tokenizeRegex(regex);
+    ParseSession session;
+    parseRegex(regex, session);
+    return std::move(session.tree);
+}
+
+ParseTree& parseRegex(std::string regex, ParseSession& session) {
+    session.reset();
+    _RegexParser parser(regex, session.tree);
+    parser.parse();
+    return session.tree;
+}
 
-    std::map<std::string, sdtcallback> translationMap;
-    translationMap["NUCLEUS"] = &_sdt_nucleus;
-    translationMap["ATOM"]    = &_sdt_atom;
-    translationMap["SEQLIST"] = &_sdt_seqlist;
-    translationMap["SEQ"]     = &_sdt_seqlist;
-    translationMap["ALTLIST"] = &_sdt_altlist;
-    translationMap["ALT"]     = &_sdt_alt;
-    translationMap["RE"]      = &_sdt_re;
+// parses through the generic LL(1) machinery with the _llre grammar, producing the same AST as
+// parseRegex. Kept as the reference implementation of the regex syntax
+ParseTree& parseRegexCFG(std::string regex, ParseSession& session) {
+    session.reset();
+    tokenizeRegex(regex, session.tokens);
 
-    std::pair<bool, ParseTree> result = _llre.match(regexTokens, translationMap);
-    if (!result.first) throw 2;
-    return result.second;
+    if (!_llre.match(session, _regexTranslations)) throw 2;
+    return session.tree;
 }
 
 std::vector<token> tokenizeRegex(std::string regex) {
     std::vector<token> tokStream;
+    tokenizeRegex(regex, tokStream);
+    return tokStream;
+}
+
+void tokenizeRegex(std::string regex, std::vector<token>& tokStream) {
     char c;
     bool controlChar = false;
     for (int i=0; i<regex.size(); i++) {
@@ -173,18 +369,18 @@ std::vector<token> tokenizeRegex(std::string regex) {
 
         if (controlChar) {
             if (c == '\\') {
-                t = create_token("char", "\\", 1, i);
+                t = create_token("char", "\\", i);
             }
             else if (c == 's') {
-                t = create_token("char", " ", 1, i);
+                t = create_token("char", " ", i);
             }
             else if (c == 'n') {
-                t = create_token("char", "\n", 1, i);
+                t = create_token("char", "\n", i);
             }
             else {
                 std::string s;
                 s.push_back(c);
-                t = create_token("char", s, 1, i);
+                t = create_token("char", s, i);
             }
             controlChar = false;
         }
@@ -221,21 +417,309 @@ std::vector<token> tokenizeRegex(std::string regex) {
                     tokType = "char";
                     break;
             }
-            t = create_token(tokType, v, 1, i);
+            t = create_token(tokType, v, i);
         }
 
         
         tokStream.push_back(t);
     }
-    return tokStream;
+}
+
+
+// simplifies a regex AST before NFA construction without changing the language it matches:
+//  - nested sequences are spliced into their parent and single-element sequences are unwrapped
+//  - nested alternations are flattened, duplicate branches dropped and common leading
+//    elements factored out of branches (ifa|ifb -> if(a|b))
+//  - alternatives that are single chars or ranges are merged into a character class, which is
+//    kept as a pipe of disjoint, sorted char/range leaves and becomes a single edge in the NFA
+//  - stacked repetition operators collapse ((a*)* -> a*, (a+)* -> a*, (a+)+ -> a+)
+class _RegexSimplifier {
+    private:
+        ParseTree& ast;
+        int seqLabel, pipeLabel, kleeneLabel, plusLabel, charLabel, rangeLabel;
+
+        int simplify(int node);
+        int simplifySeq(int node);
+        int simplifyPipe(int node);
+        int simplifyRepeat(int node);
+
+        bool equal(int a, int b);
+        bool isClassMember(int node);
+        int addNode(int label, std::string value);
+        int makeSeq(std::vector<int>& items, int from);
+        int makeClass(char_class& chars);
+    public:
+        _RegexSimplifier(ParseTree& ast);
+        void run();
+};
+
+_RegexSimplifier::_RegexSimplifier(ParseTree& ast) : ast(ast) {
+    std::map<std::string, int> smap = _llre.getSymbolMap();
+    seqLabel = smap["SEQ"];
+    pipeLabel = smap["pipe"];
+    kleeneLabel = smap["kleene"];
+    plusLabel = smap["plus"];
+    charLabel = smap["char"];
+    rangeLabel = smap["range"];
+}
+
+void _RegexSimplifier::run() {
+    int root = ast.rootNode();
+    // copied, since adding nodes can move the tree's child lists
+    std::vector<int> children = *ast.getChildren(root);
+    for (int i=0; i<children.size(); i++) {
+        int child = children[i];
+        int simplified = simplify(child);
+        if (simplified != child) {
+            ast.removeChild(root, child);
+            ast.insertChild(root, simplified, i);
+        }
+    }
+}
+
+int _RegexSimplifier::addNode(int label, std::string value) {
+    tree_metadata meta;
+    meta.value = value;
+    return ast.addNode(label, meta);
+}
+
+int _RegexSimplifier::simplify(int node) {
+    int label = ast.getLabel(node);
+    if (label == seqLabel) return simplifySeq(node);
+    if (label == pipeLabel) return simplifyPipe(node);
+    if (label == kleeneLabel || label == plusLabel) return simplifyRepeat(node);
+    return node;
+}
+
+int _RegexSimplifier::simplifySeq(int node) {
+    std::vector<int> children = *ast.getChildren(node);
+    std::vector<int> items;
+    for (int child : children) {
+        ast.removeChild(node, child);
+        int simplified = simplify(child);
+        // nested sequences (including empty ones) are spliced in place
+        if (ast.getLabel(simplified) == seqLabel) {
+            std::vector<int> grandchildren = *ast.getChildren(simplified);
+            items.insert(items.end(), grandchildren.begin(), grandchildren.end());
+        }
+        else {
+            items.push_back(simplified);
+        }
+    }
+    if (items.size() == 1) return items[0];
+
+    for (int item : items) ast.addChild(node, item);
+    return node;
+}
+
+int _RegexSimplifier::simplifyRepeat(int node) {
+    int child = ast.getChildren(node)->at(0);
+    int simplified = simplify(child);
+    int childLabel = ast.getLabel(simplified);
+    if (childLabel == kleeneLabel || childLabel == plusLabel) {
+        // only a+ under a + stays a +, any other stacking is a kleene
+        if (ast.getLabel(node) == kleeneLabel || childLabel == kleeneLabel) {
+            int inner = ast.getChildren(simplified)->at(0);
+            if (childLabel == kleeneLabel) return simplified;
+            ast.removeChild(simplified, inner);
+            ast.removeChild(node, child);
+            int kleene = addNode(kleeneLabel, "*");
+            ast.addChild(kleene, inner);
+            return kleene;
+        }
+        return simplified;
+    }
+    if (simplified != child) {
+        ast.removeChild(node, child);
+        ast.addChild(node, simplified);
+    }
+    return node;
+}
+
+bool _RegexSimplifier::equal(int a, int b) {
+    if (ast.getLabel(a) != ast.getLabel(b)) return false;
+    if (ast.getMetadata(a)->value != ast.getMetadata(b)->value) return false;
+    std::vector<int>& ac = *ast.getChildren(a);
+    std::vector<int>& bc = *ast.getChildren(b);
+    if (ac.size() != bc.size()) return false;
+    for (int i=0; i<ac.size(); i++) {
+        if (!equal(ac[i], bc[i])) return false;
+    }
+    return true;
+}
+
+// single chars and well-formed ranges can be folded into a class. Reversed ranges are left
+// alone so that NFA construction still reports them
+bool _RegexSimplifier::isClassMember(int node) {
+    int label = ast.getLabel(node);
+    if (label == charLabel) return true;
+    if (label != rangeLabel) return false;
+    char first = ast.getMetadata(ast.getChildren(node)->at(0))->value.at(0);
+    char last = ast.getMetadata(ast.getChildren(node)->at(1))->value.at(0);
+    return first <= last;
+}
+
+int _RegexSimplifier::makeSeq(std::vector<int>& items, int from) {
+    if (items.size() - from == 1) return items[from];
+    int seq = addNode(seqLabel, "");
+    for (int i=from; i<items.size(); i++) ast.addChild(seq, items[i]);
+    return seq;
+}
+
+int _RegexSimplifier::makeClass(char_class& chars) {
+    std::vector<int> members;
+    int c = 0;
+    while (c < 256) {
+        if (!chars.test(c)) {
+            c++;
+            continue;
+        }
+        int end = c;
+        while (end + 1 < 256 && chars.test(end + 1)) end++;
+
+        int first = addNode(charLabel, std::string(1, (char)c));
+        if (end == c) {
+            members.push_back(first);
+        }
+        else {
+            int range = addNode(rangeLabel, "-");
+            ast.addChild(range, first);
+            ast.addChild(range, addNode(charLabel, std::string(1, (char)end)));
+            members.push_back(range);
+        }
+        c = end + 1;
+    }
+    if (members.size() == 1) return members[0];
+
+    int pipe = addNode(pipeLabel, "|");
+    for (int member : members) ast.addChild(pipe, member);
+    return pipe;
+}
+
+int _RegexSimplifier::simplifyPipe(int node) {
+    std::vector<int> children = *ast.getChildren(node);
+    std::vector<int> branches;
+    for (int child : children) {
+        ast.removeChild(node, child);
+        int simplified = simplify(child);
+        if (ast.getLabel(simplified) == pipeLabel) {
+            std::vector<int> grandchildren = *ast.getChildren(simplified);
+            branches.insert(branches.end(), grandchildren.begin(), grandchildren.end());
+        }
+        else {
+            branches.push_back(simplified);
+        }
+    }
+
+    // view every branch as a sequence of items; an empty SEQ is the empty string
+    std::vector<std::vector<int>> items;
+    for (int branch : branches) {
+        if (ast.getLabel(branch) == seqLabel) items.push_back(*ast.getChildren(branch));
+        else items.push_back(std::vector<int>(1, branch));
+    }
+
+    std::vector<int> result;
+    std::vector<bool> used(branches.size(), false);
+    char_class classChars;
+    int classMembers = 0;
+    for (int i=0; i<branches.size(); i++) {
+        if (used[i]) continue;
+        used[i] = true;
+
+        if (items[i].size() == 0) {
+            bool duplicate = false;
+            for (int r : result) {
+                if (ast.getLabel(r) == seqLabel && ast.getChildren(r)->size() == 0) duplicate = true;
+            }
+            if (!duplicate) result.push_back(branches[i]);
+            continue;
+        }
+
+        // gather every later branch starting with the same element
+        std::vector<int> group(1, i);
+        for (int j=i+1; j<branches.size(); j++) {
+            if (!used[j] && items[j].size() > 0 && equal(items[i][0], items[j][0])) {
+                group.push_back(j);
+                used[j] = true;
+            }
+        }
+
+        if (group.size() == 1) {
+            if (items[i].size() == 1 && isClassMember(items[i][0])) {
+                int member = items[i][0];
+                int label = ast.getLabel(member);
+                char first = ast.getMetadata(label == charLabel ? member : ast.getChildren(member)->at(0))->value.at(0);
+                char last = ast.getMetadata(label == charLabel ? member : ast.getChildren(member)->at(1))->value.at(0);
+                for (int c = (unsigned char)first; c <= (unsigned char)last; c++) classChars.set(c);
+                classMembers++;
+            }
+            else {
+                result.push_back(branches[i]);
+            }
+            continue;
+        }
+
+        // factor the shared head out: x A | x B  ->  x (A | B)
+        int rest = addNode(pipeLabel, "|");
+        for (int g : group) {
+            std::vector<int>& tail = items[g];
+            if (tail.size() == 1) ast.addChild(rest, addNode(seqLabel, ""));
+            else ast.addChild(rest, makeSeq(tail, 1));
+        }
+        int factored = addNode(seqLabel, "");
+        ast.addChild(factored, items[i][0]);
+        ast.addChild(factored, rest);
+        result.push_back(simplify(factored));
+    }
+
+    if (classMembers > 0) result.push_back(makeClass(classChars));
+    if (result.size() == 1) return result[0];
+
+    for (int r : result) ast.addChild(node, r);
+    return node;
+}
+
+// simplifies a regex AST in place (see _RegexSimplifier)
+void simplifyRegex(ParseTree& ast) {
+    _RegexSimplifier simplifier(ast);
+    simplifier.run();
+}
+
+// collects the characters of a char, a range, or a pipe made only of chars and ranges (a
+// character class left by simplifyRegex). Returns false for any other node
+bool _classChars(ParseTree& ast, std::map<int, std::string>& rsmap, int node, char_class& chars) {
+    std::string strLabel = rsmap[ast.getLabel(node)];
+    if (strLabel == "char") {
+        chars.set((unsigned char)ast.getMetadata(node)->value.at(0));
+        return true;
+    }
+    if (strLabel == "range") {
+        char asciiStart = ast.getMetadata(ast.getChildren(node)->at(0))->value.at(0);
+        char asciiEnd = ast.getMetadata(ast.getChildren(node)->at(1))->value.at(0);
+        if (asciiStart > asciiEnd) throw 3;  // code for semantic error
+        for (char c = asciiStart; c <= asciiEnd; c++) {
+            chars.set((unsigned char)c);
+        }
+        return true;
+    }
+    if (strLabel != "pipe") return false;
+
+    char_class members;
+    for (int child : *ast.getChildren(node)) {
+        std::string childLabel = rsmap[ast.getLabel(child)];
+        if (childLabel != "char" && childLabel != "range") return false;
+        _classChars(ast, rsmap, child, members);
+    }
+    chars |= members;
+    return true;
 }
 
 
 class _RegexToNFA {
     private:
-        ParseTree ast;
-        std::vector<char> alphabet;
-        std::map<int, std::string> rsmap;
+        ParseTree& ast;
+        const std::vector<char>& alphabet;
+        std::map<int, std::string>& rsmap;
         NFABuilder* nfa;
 
         void lambdaWrap(int node, int src, int dst);
@@ -249,15 +733,13 @@ class _RegexToNFA {
         void processRange(int node, int src, int dst);
     
     public:
-        _RegexToNFA(ParseTree ast, std::vector<char> alphabet, std::map<int, std::string> rsmap);
+        _RegexToNFA(ParseTree& ast, const std::vector<char>& alphabet, std::map<int, std::string>& rsmap);
 
         NFABuilder convert(int node);
 };
 
-_RegexToNFA::_RegexToNFA(ParseTree ast, std::vector<char> alphabet, std::map<int, std::string> rsmap) {
-    this->ast = ast;
-    this->alphabet = alphabet;
-    this->rsmap = rsmap;
+_RegexToNFA::_RegexToNFA(ParseTree& ast, const std::vector<char>& alphabet, std::map<int, std::string>& rsmap)
+    : ast(ast), alphabet(alphabet), rsmap(rsmap) {
 }
 
 void _RegexToNFA::processChild(int node, int src, int dst) {
@@ -297,7 +779,7 @@ void _RegexToNFA::lambdaWrap(int node, int src, int dst) {
     processChild(node, left, right);
 }
 void _RegexToNFA::processSeq(int node, int src, int dst) {
-    int childdest;
+    int childdest = src;  // an empty sequence is a single lambda
     for (int child : *ast.getChildren(node)) {
         childdest = nfa->addState();
         lambdaWrap(child, src, childdest);
@@ -306,6 +788,11 @@ void _RegexToNFA::processSeq(int node, int src, int dst) {
     nfa->addLambda(childdest, dst);
 }
 void _RegexToNFA::processPipe(int node, int src, int dst) {
+    char_class chars;
+    if (_classChars(ast, rsmap, node, chars)) {
+        nfa->addClassEdge(src, dst, chars);
+        return;
+    }
     for (int child : *ast.getChildren(node)) {
         lambdaWrap(child, src, dst);
     }
@@ -332,14 +819,18 @@ void _RegexToNFA::processRange(int node, int src, int dst) {
     char asciiStart = ast.getMetadata(leftChild)->value.at(0);
     char asciiEnd = ast.getMetadata(rightChild)->value.at(0);
     if (asciiStart > asciiEnd) throw 3;  // code for semantic error
+    char_class chars;
     for (char c = asciiStart; c <= asciiEnd; c++) {
-        nfa->addEdge(src, dst, c);
+        chars.set((unsigned char)c);
     }
+    nfa->addClassEdge(src, dst, chars);
 }
 void _RegexToNFA::processDot(int node, int src, int dst) {
+    char_class chars;
     for (char c : alphabet) {
-        nfa->addEdge(src, dst, c);
+        chars.set((unsigned char)c);
     }
+    nfa->addClassEdge(src, dst, chars);
 }
 
 NFABuilder _RegexToNFA::convert(int node) {
@@ -356,7 +847,207 @@ NFABuilder _RegexToNFA::convert(int node) {
 
 
 // converts a regex AST into an NFA implementation
-NFABuilder nfaRegex(ParseTree& ast, std::vector<char> alphabet, rsymbolmap rsmap) {
+NFABuilder nfaRegex(ParseTree& ast, const std::vector<char>& alphabet, rsymbolmap rsmap) {
     _RegexToNFA r(ast, alphabet, rsmap);
     return r.convert(ast.rootNode());
 }
+
+
+
+// builds the Glushkov (position) automaton of a regex AST: one state per char/range/dot leaf
+// plus a start state, and no lambda edges at all
+class _RegexToGlushkov {
+    private:
+        struct glushkov_info {
+            bool nullable;
+            std::vector<int> first;
+            std::vector<int> last;
+        };
+
+        ParseTree& ast;
+        const std::vector<char>& alphabet;
+        std::map<int, std::string>& rsmap;
+
+        // index 0 is the start state, every other index is a position
+        std::vector<std::vector<char>> positionChars;
+        std::vector<std::set<int>> follow;
+
+        int addPosition(std::vector<char> chars);
+        void addFollow(std::vector<int>& from, std::vector<int>& to);
+        glushkov_info process(int node);
+    public:
+        _RegexToGlushkov(ParseTree& ast, const std::vector<char>& alphabet, std::map<int, std::string>& rsmap);
+
+        Definition convert(int node);
+};
+
+_RegexToGlushkov::_RegexToGlushkov(ParseTree& ast, const std::vector<char>& alphabet, std::map<int, std::string>& rsmap)
+    : ast(ast), alphabet(alphabet), rsmap(rsmap) {
+}
+
+int _RegexToGlushkov::addPosition(std::vector<char> chars) {
+    positionChars.push_back(chars);
+    follow.push_back(std::set<int>());
+    return positionChars.size() - 1;
+}
+
+void _RegexToGlushkov::addFollow(std::vector<int>& from, std::vector<int>& to) {
+    for (int p : from) {
+        follow[p].insert(to.begin(), to.end());
+    }
+}
+
+_RegexToGlushkov::glushkov_info _RegexToGlushkov::process(int node) {
+    std::string strLabel = rsmap[ast.getLabel(node)];
+    std::vector<int>& children = *ast.getChildren(node);
+    glushkov_info info;
+    char_class classChars;
+
+    if (strLabel == "RE") {
+        return process(children.at(0));
+    }
+    else if (strLabel == "SEQ") {
+        info.nullable = true;
+        for (int child : children) {
+            glushkov_info c = process(child);
+            addFollow(info.last, c.first);
+            if (info.nullable) info.first.insert(info.first.end(), c.first.begin(), c.first.end());
+            if (c.nullable) info.last.insert(info.last.end(), c.last.begin(), c.last.end());
+            else info.last = c.last;
+            info.nullable = info.nullable && c.nullable;
+        }
+    }
+    else if (strLabel == "pipe" && !_classChars(ast, rsmap, node, classChars)) {
+        info.nullable = false;
+        for (int child : children) {
+            glushkov_info c = process(child);
+            info.first.insert(info.first.end(), c.first.begin(), c.first.end());
+            info.last.insert(info.last.end(), c.last.begin(), c.last.end());
+            info.nullable = info.nullable || c.nullable;
+        }
+    }
+    else if (strLabel == "kleene" || strLabel == "plus") {
+        info = process(children.at(0));
+        addFollow(info.last, info.first);
+        if (strLabel == "kleene") info.nullable = true;
+    }
+    else {
+        // chars, ranges and character classes are each a single position
+        std::vector<char> chars;
+        if (strLabel == "dot") {
+            chars = alphabet;
+        }
+        else {
+            _classChars(ast, rsmap, node, classChars);
+            for (int c = 0; c < 256; c++) {
+                if (classChars.test(c)) chars.push_back((char)c);
+            }
+        }
+        int position = addPosition(chars);
+        info.nullable = false;
+        info.first.push_back(position);
+        info.last.push_back(position);
+    }
+    return info;
+}
+
+Definition _RegexToGlushkov::convert(int node) {
+    int start = addPosition(std::vector<char>());
+    glushkov_info root = process(node);
+    follow[start].insert(root.first.begin(), root.first.end());
+
+    std::vector<bool> accepting(positionChars.size(), false);
+    for (int p : root.last) accepting[p] = true;
+    accepting[start] = root.nullable;
+
+    std::vector<char> alphabetCopy = alphabet;
+    Definition def;
+    def.head.alphabet = alphabet;
+    def.head.lambda = _unusedCharacter(alphabetCopy);
+    def.head.stateCount = positionChars.size();
+
+    // every edge into a position carries that position's characters
+    for (int from = 0; from < positionChars.size(); from++) {
+        for (int to : follow[from]) {
+            DefinitionLine line;
+            line.accepting = accepting[from];
+            line.from = from;
+            line.to = to;
+            line.transitionCharacters = positionChars[to];
+            def.lines.push_back(line);
+        }
+        if (follow[from].size() == 0 && accepting[from]) {
+            DefinitionLine acc;
+            acc.accepting = true;
+            acc.from = from;
+            acc.to = from;
+            def.lines.push_back(acc);
+        }
+    }
+
+    return def;
+}
+
+// converts a regex AST into a lambda-free position automaton
+Definition glushkovRegex(ParseTree& ast, const std::vector<char>& alphabet, rsymbolmap rsmap) {
+    _RegexToGlushkov g(ast, alphabet, rsmap);
+    return g.convert(ast.rootNode());
+}
+
+RegexCache::RegexCache(int capacity) {
+    this->capacity = capacity;
+    this->rsmap = _llre.getReverseSymbolMap();
+}
+
+RegexCache::entry& RegexCache::lookup(const std::string& regex, const std::vector<char>& alphabet) {
+    std::pair<std::string, std::string> key(regex, std::string(alphabet.begin(), alphabet.end()));
+    auto itr = index.find(key);
+    if (itr != index.end()) {
+        // move to the front of the recency list
+        entries.splice(entries.begin(), entries, itr->second);
+        return entries.front();
+    }
+
+    // compile before touching the cache so a bad regex doesn't leave an entry behind
+    StatsPhase parsePhase("regex parse");
+    ParseTree& ast = parseRegex(regex, session);
+    simplifyRegex(ast);
+    parsePhase.stop();
+    StatsPhase buildPhase("nfa build");
+    NFABuilder nfa = nfaRegex(ast, alphabet, rsmap);
+    buildPhase.stop();
+
+    if (entries.size() >= capacity && entries.size() > 0) {
+        entry& oldest = entries.back();
+        index.erase(std::make_pair(oldest.regex, oldest.alphabet));
+        entries.pop_back();
+    }
+
+    entries.push_front({ regex, key.second, nfa, std::nullopt });
+    index[key] = entries.begin();
+    return entries.front();
+}
+
+NFABuilder& RegexCache::compile(const std::string& regex, const std::vector<char>& alphabet) {
+    return lookup(regex, alphabet).nfa;
+}
+
+DFA& RegexCache::compileDFA(const std::string& regex, const std::vector<char>& alphabet) {
+    entry& e = lookup(regex, alphabet);
+    if (!e.dfa.has_value()) {
+        NFA nfa(e.nfa.toDefinition(alphabet));
+        DFA dfa = nfa.toDFA();
+        dfa.optimize();
+        e.dfa = dfa;
+    }
+    return e.dfa.value();
+}
+
+int RegexCache::size() {
+    return entries.size();
+}
+
+void RegexCache::clear() {
+    entries.clear();
+    index.clear();
+}
@@ -2,11 +2,44 @@
 
 #include <vector>
 #include <string>
+#include <list>
+#include <optional>
 #include "lexer.h"
 #include "cfg.h"
 #include "nfa.h"
 
 std::vector<token> tokenizeRegex(std::string regex);
+void tokenizeRegex(std::string regex, std::vector<token>& tokStream);
 ParseTree parseRegex(std::string regex);
-NFABuilder nfaRegex(ParseTree& ast, std::vector<char> alphabet, std::map<int, std::string>& rsmap);
+ParseTree& parseRegex(std::string regex, ParseSession& session);
+ParseTree& parseRegexCFG(std::string regex, ParseSession& session);
+void simplifyRegex(ParseTree& ast);
+NFABuilder nfaRegex(ParseTree& ast, const std::vector<char>& alphabet, std::map<int, std::string>& rsmap);
+Definition glushkovRegex(ParseTree& ast, const std::vector<char>& alphabet, std::map<int, std::string>& rsmap);
 CFG llre();
+
+// least-recently-used cache of compiled regexes, keyed by (regex, alphabet). Compiling a
+// pattern that is already cached is a lookup; the DFA is only built the first time it's asked for
+class RegexCache {
+    private:
+        struct entry {
+            std::string regex;
+            std::string alphabet;
+            NFABuilder nfa;
+            std::optional<DFA> dfa;
+        };
+
+        int capacity;
+        std::list<entry> entries;  // most recently used first
+        std::map<std::pair<std::string, std::string>, std::list<entry>::iterator> index;
+        std::map<int, std::string> rsmap;
+        ParseSession session;  // reused by every compile, so each cache is only safe on one thread
+
+        entry& lookup(const std::string& regex, const std::vector<char>& alphabet);
+    public:
+        RegexCache(int capacity = 512);
+        NFABuilder& compile(const std::string& regex, const std::vector<char>& alphabet);
+        DFA& compileDFA(const std::string& regex, const std::vector<char>& alphabet);
+        int size();
+        void clear();
+};
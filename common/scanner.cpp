@@ -0,0 +1,158 @@
+#include <iostream>
+#include <map>
+#include "scanner.h"
+#include "trace.h"
+
+ScannerTable::ScannerTable(std::vector<char> alphabet, std::vector<DFA> dfas, const dfa_limits& limits) {
+    TRACE_SCOPE("ScannerTable::build");
+    this->alphabet = alphabet;
+
+    // a tuple holds one state per token DFA, -1 for tokens that can no longer match
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int>> tuples;
+    std::vector<int> start(dfas.size(), 0);
+    ids[start] = 0;
+    tuples.push_back(start);
+
+    for (int s = 0; s < tuples.size(); s++) {
+        if (limits.maxStates > 0 && tuples.size() > limits.maxStates) {
+            std::cerr << "ERROR: combined scanner exceeded the limit of " << limits.maxStates << " states" << std::endl;
+            throw 4;
+        }
+        // the tuple map dominates, each entry holds a copy of the tuple
+        size_t bytes = tuples.size() * (256 * sizeof(int) + 2 * dfas.size() * sizeof(int));
+        if (limits.maxBytes > 0 && bytes > limits.maxBytes) {
+            std::cerr << "ERROR: combined scanner exceeded the limit of " << limits.maxBytes << " bytes" << std::endl;
+            throw 4;
+        }
+
+        int accepting = -1;
+        for (int i = 0; i < dfas.size(); i++) {
+            if (dfas[i].isAccepting(tuples[s][i])) {
+                accepting = i;
+                break;
+            }
+        }
+        acceptTokens.push_back(accepting);
+        table.resize(tuples.size() * 256, -1);
+
+        for (char c : alphabet) {
+            std::vector<int> next(dfas.size());
+            bool alive = false;
+            for (int i = 0; i < dfas.size(); i++) {
+                next[i] = dfas[i].transition(tuples[s][i], c);
+                alive = alive || next[i] != -1;
+            }
+            if (!alive) continue;
+
+            auto itr = ids.find(next);
+            int to;
+            if (itr == ids.end()) {
+                to = tuples.size();
+                ids[next] = to;
+                tuples.push_back(next);
+            }
+            else to = itr->second;
+            table[s * 256 + (unsigned char)c] = to;
+        }
+    }
+    states = tuples.size();
+    table.resize(states * 256, -1);
+
+    minimize();
+}
+
+// Moore refinement: states start out split by accepting token and are split further until
+// every state in a block moves to the same blocks. Blocks are then numbered from the start in
+// breadth-first order
+void ScannerTable::minimize() {
+    std::vector<int> block(states);
+    std::map<int, int> firstBlocks;
+    for (int s = 0; s < states; s++) {
+        auto itr = firstBlocks.emplace(acceptTokens[s], firstBlocks.size()).first;
+        block[s] = itr->second;
+    }
+    int blockCount = firstBlocks.size();
+
+    while (true) {
+        std::map<std::vector<int>, int> signatures;
+        std::vector<int> refined(states);
+        for (int s = 0; s < states; s++) {
+            std::vector<int> signature;
+            signature.push_back(block[s]);
+            for (char c : alphabet) {
+                int to = table[s * 256 + (unsigned char)c];
+                signature.push_back(to == -1 ? -1 : block[to]);
+            }
+            refined[s] = signatures.emplace(signature, signatures.size()).first->second;
+        }
+        block.swap(refined);
+        if (signatures.size() == blockCount) break;
+        blockCount = signatures.size();
+    }
+
+    std::vector<int> representative(blockCount, -1);
+    for (int s = 0; s < states; s++) {
+        if (representative[block[s]] == -1) representative[block[s]] = s;
+    }
+
+    std::vector<int> order(blockCount, -1);
+    std::vector<int> queue = { block[0] };
+    order[block[0]] = 0;
+    for (int q = 0; q < queue.size(); q++) {
+        int rep = representative[queue[q]];
+        for (char c : alphabet) {
+            int to = table[rep * 256 + (unsigned char)c];
+            if (to == -1 || order[block[to]] != -1) continue;
+            order[block[to]] = queue.size();
+            queue.push_back(block[to]);
+        }
+    }
+
+    std::vector<int> newTable(queue.size() * 256, -1);
+    std::vector<int> newAccept(queue.size());
+    for (int q = 0; q < queue.size(); q++) {
+        int rep = representative[queue[q]];
+        newAccept[q] = acceptTokens[rep];
+        for (char c : alphabet) {
+            int to = table[rep * 256 + (unsigned char)c];
+            if (to != -1) newTable[q * 256 + (unsigned char)c] = order[block[to]];
+        }
+    }
+    table.swap(newTable);
+    acceptTokens.swap(newAccept);
+    states = queue.size();
+}
+
+const std::vector<char>& ScannerTable::getAlphabet() {
+    return alphabet;
+}
+
+int ScannerTable::stateCount() {
+    return states;
+}
+
+int ScannerTable::transition(int s, char c) {
+    if (s < 0) return -1;
+    return table[s * 256 + (unsigned char)c];
+}
+
+int ScannerTable::acceptingToken(int s) {
+    if (s < 0) return -1;
+    return acceptTokens[s];
+}
+
+int ScannerTable::longestMatch(std::string_view text, int pos, int& tokenIndex) {
+    int state = 0;
+    int end = -1;
+    tokenIndex = -1;
+    for (int i = pos; state != -1; i++) {
+        if (acceptTokens[state] != -1) {
+            end = i;
+            tokenIndex = acceptTokens[state];
+        }
+        if (i == text.size()) break;
+        state = table[state * 256 + (unsigned char)text[i]];
+    }
+    return end;
+}
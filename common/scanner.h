@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+#include "dfa.h"
+#include "nfa.h"
+
+// every token DFA of a scanner folded into one DFA over tuples of their states, then minimized.
+// Each state records the earliest token accepting there, so Lexer's rule (longest match, ties
+// to the token defined first) becomes a single walk that remembers the last accepting state
+class ScannerTable {
+    private:
+        std::vector<char> alphabet;
+        std::vector<int> table;        // state * 256 + (unsigned char)c, -1 once every token is dead
+        std::vector<int> acceptTokens;  // per state, -1 when no token accepts
+        int states = 0;
+
+        void minimize();
+    public:
+        // throws 4 when the product passes the limits, like NFA::toDFA
+        ScannerTable(std::vector<char> alphabet, std::vector<DFA> dfas, const dfa_limits& limits = dfa_limits());
+        const std::vector<char>& getAlphabet();
+        int stateCount();
+        int transition(int s, char c);
+        int acceptingToken(int s);
+
+        // end of the longest match starting at pos and the token it belongs to, or -1 if nothing matches
+        int longestMatch(std::string_view text, int pos, int& tokenIndex);
+};
@@ -0,0 +1,140 @@
+#include <map>
+#include <iostream>
+#include <algorithm>
+#include "search.h"
+
+// subset construction over the flipped forward edges. Reading c backwards from the set S gives
+// every state with a c edge into S, plus the accepting states since an end can be right here.
+// Characters outside the alphabet have no edges, so they lead back to the accepting set alone
+DFASearch::DFASearch(DFA dfa, const dfa_limits& limits) : forward(dfa) {
+    if (forward.flatTable.empty()) forward.flatten();
+    forwardStates = forward.flatAccepting.size();
+
+    // predecessors[c][t] lists the states whose c edge goes to t
+    std::vector<std::vector<std::vector<int>>> predecessors(256);
+    for (char c : forward.alphabet) {
+        std::vector<std::vector<int>>& row = predecessors[(unsigned char)c];
+        row.resize(forwardStates);
+        for (int q = 0; q < forwardStates; q++) {
+            int t = forward.flatTable[q * 256 + (unsigned char)c];
+            if (t != -1) row[t].push_back(q);
+        }
+    }
+
+    std::vector<char> accepting(forward.flatAccepting.begin(), forward.flatAccepting.end());
+    std::map<std::vector<char>, int> ids;
+    std::vector<std::vector<char>> sets = { accepting };
+    ids[accepting] = 0;
+    backStart = 0;
+
+    for (int s = 0; s < sets.size(); s++) {
+        if (limits.maxStates > 0 && sets.size() > limits.maxStates) {
+            std::cerr << "ERROR: search automaton exceeded the limit of " << limits.maxStates << " states" << std::endl;
+            throw 4;
+        }
+        // every set is held twice, in sets and as a key of ids, beside its row of the table
+        size_t bytes = sets.size() * (2 * forwardStates + 256 * sizeof(int) + 4 * sizeof(void*));
+        if (limits.maxBytes > 0 && bytes > limits.maxBytes) {
+            std::cerr << "ERROR: search automaton exceeded the limit of " << limits.maxBytes << " bytes" << std::endl;
+            throw 4;
+        }
+        backTable.resize(sets.size() * 256, backStart);
+        for (char c : forward.alphabet) {
+            std::vector<std::vector<int>>& row = predecessors[(unsigned char)c];
+            std::vector<char> next = accepting;
+            for (int t = 0; t < forwardStates; t++) {
+                if (!sets[s][t]) continue;
+                for (int q : row[t]) next[q] = 1;
+            }
+
+            auto itr = ids.find(next);
+            int to;
+            if (itr == ids.end()) {
+                to = sets.size();
+                ids[next] = to;
+                sets.push_back(next);
+            }
+            else to = itr->second;
+            backTable[s * 256 + (unsigned char)c] = to;
+        }
+    }
+    backTable.resize(sets.size() * 256, backStart);
+
+    live.reserve(sets.size() * forwardStates);
+    for (std::vector<char>& set : sets) live.insert(live.end(), set.begin(), set.end());
+}
+
+// backward states are kept for one block in SEARCH_BLOCK positions, plus the two blocks the
+// forward pass is working in, so memory stays bounded however large the text is
+const size_t SEARCH_BLOCK = 1 << 16;
+
+void DFASearch::search(std::string_view text, const std::function<void(size_t, size_t)>& onMatch) {
+    size_t n = text.size();
+    const int* btable = backTable.data();
+    const int* ftable = forward.flatTable.data();
+    const char* liveSets = live.data();
+    std::vector<char> faccepting(forward.flatAccepting.begin(), forward.flatAccepting.end());
+
+    // backward pass: checkpoints[b] is the set of forward states that can reach an end reading
+    // from position min(b * SEARCH_BLOCK, n)
+    size_t blocks = n / SEARCH_BLOCK + 1;
+    std::vector<int> checkpoints(blocks + 1, backStart);
+    int state = backStart;
+    for (size_t i = n; i > 0; i--) {
+        if (i % SEARCH_BLOCK == 0) checkpoints[i / SEARCH_BLOCK] = state;
+        state = btable[state * 256 + (unsigned char)text[i - 1]];
+    }
+    checkpoints[0] = state;
+
+    // a block's states are replayed from the checkpoint at its end when the forward pass gets
+    // there. The forward pass only looks back one position, so two cached blocks are enough
+    std::vector<int> cached[2] = { std::vector<int>(SEARCH_BLOCK + 1), std::vector<int>(SEARCH_BLOCK + 1) };
+    size_t cachedBlock[2] = { blocks, blocks };
+    int older = 0;
+    auto back = [&](size_t i) {
+        size_t b = i / SEARCH_BLOCK;
+        size_t first = b * SEARCH_BLOCK;
+        if (cachedBlock[0] == b) return cached[0][i - first];
+        if (cachedBlock[1] == b) return cached[1][i - first];
+
+        std::vector<int>& states = cached[older];
+        cachedBlock[older] = b;
+        older = 1 - older;
+        size_t last = std::min(first + SEARCH_BLOCK, n);
+        int s = checkpoints[b + 1];
+        states[last - first] = s;
+        for (size_t j = last; j > first; j--) {
+            s = btable[s * 256 + (unsigned char)text[j - 1]];
+            states[j - 1 - first] = s;
+        }
+        return states[i - first];
+    };
+
+    // forward pass: a match starts at i when the start state is live there, and its extension
+    // stops once the current state can't reach any further end
+    size_t pos = 0;
+    while (pos <= n) {
+        if (!liveSets[(size_t)back(pos) * forwardStates]) {
+            pos++;
+            continue;
+        }
+
+        size_t end = pos;
+        state = 0;
+        for (size_t i = pos; i < n; i++) {
+            state = ftable[state * 256 + (unsigned char)text[i]];
+            if (state == -1 || !liveSets[(size_t)back(i + 1) * forwardStates + state]) break;
+            if (faccepting[state]) end = i + 1;
+        }
+        onMatch(pos, end);
+        pos = end > pos ? end : pos + 1;
+    }
+}
+
+std::vector<std::pair<size_t, size_t>> DFASearch::findAll(std::string_view text) {
+    std::vector<std::pair<size_t, size_t>> spans;
+    search(text, [&](size_t start, size_t end) {
+        spans.push_back(std::make_pair(start, end));
+    });
+    return spans;
+}
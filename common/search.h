@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <functional>
+#include "dfa.h"
+#include "nfa.h"
+
+// finds every leftmost-longest, non-overlapping match of a DFA inside a larger buffer in linear
+// time. A backward pass records, for every position, which forward states can still reach an
+// accepting end from there; a match starts wherever the start state is among them. The forward
+// pass extends each match with the anchored table and stops as soon as its state can't reach
+// another end, so it reads at most one byte past each match and never rescans text. Backward
+// states are only stored at block boundaries and replayed a block at a time, so apart from the
+// text itself memory stays small enough to search a mapped multi-GB file
+class DFASearch {
+    private:
+        DFA forward;
+        int forwardStates = 0;
+
+        // determinized backward automaton, each state a set of forward states that can still
+        // reach an accepting end. live holds those sets as state * forwardStates + forwardState
+        std::vector<int> backTable;  // state * 256 + (unsigned char)c
+        std::vector<char> live;
+        int backStart = 0;           // the set of accepting forward states, where every scan begins
+
+    public:
+        // the backward automaton can be exponentially larger than dfa, so it takes the same
+        // limits as NFA::toDFA and throws 4 when they're passed
+        DFASearch(DFA dfa, const dfa_limits& limits = dfa_limits());
+        void search(std::string_view text, const std::function<void(size_t, size_t)>& onMatch);
+        std::vector<std::pair<size_t, size_t>> findAll(std::string_view text);
+};
@@ -5,6 +5,7 @@
 #include <set>
 #include <unordered_set>
 #include <map>
+#include <bitset>
 
 template <typename T>
 std::ostream& operator<<(std::ostream& os, const std::vector<T>& v) {
@@ -53,9 +54,12 @@ std::ostream& operator<<(std::ostream& os, const std::map<U, V>& m) {
     return os;
 }
 
+// set of characters labeling a single edge, indexed by (unsigned char)
+typedef std::bitset<256> char_class;
+
 struct Transition {
     int to;
-    char token;
+    char_class chars;
 };
 
 struct StateInfo {
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+#include "stats.h"
+
+struct _stats_entry {
+    std::string name;
+    long long value;  // nanoseconds for phases
+    int calls;
+};
+
+struct _stats_state {
+    bool enabled = false;
+    bool json = false;
+    // report in the order things first happened rather than alphabetically
+    std::vector<_stats_entry> phases;
+    std::vector<_stats_entry> counters;
+    std::map<std::string, int> phaseIndex;
+    std::map<std::string, int> counterIndex;
+};
+
+_stats_state& _stats() {
+    static _stats_state state;
+    return state;
+}
+
+_stats_entry& _statsEntry(std::vector<_stats_entry>& entries, std::map<std::string, int>& index, const std::string& name) {
+    auto itr = index.find(name);
+    if (itr != index.end()) return entries[itr->second];
+    index[name] = entries.size();
+    entries.push_back({ name, 0, 0 });
+    return entries.back();
+}
+
+long long _peakRSSKilobytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;  // kilobytes on linux
+}
+
+std::string _jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out;
+}
+
+void _statsReport() {
+    _stats_state& s = _stats();
+    long long peakRSS = _peakRSSKilobytes();
+
+    if (s.json) {
+        std::cerr << "{\"phases\": {";
+        for (int i = 0; i < s.phases.size(); i++) {
+            _stats_entry& p = s.phases[i];
+            std::cerr << (i > 0 ? ", " : "") << "\"" << _jsonEscape(p.name) << "\": {\"ms\": "
+                      << std::fixed << std::setprecision(3) << p.value / 1e6 << ", \"calls\": " << p.calls << "}";
+        }
+        std::cerr << "}, \"counters\": {";
+        for (int i = 0; i < s.counters.size(); i++) {
+            _stats_entry& c = s.counters[i];
+            std::cerr << (i > 0 ? ", " : "") << "\"" << _jsonEscape(c.name) << "\": " << c.value;
+        }
+        std::cerr << "}, \"peak_rss_kb\": " << peakRSS << "}" << std::endl;
+        return;
+    }
+
+    std::cerr << "STATS" << std::endl;
+    for (_stats_entry& p : s.phases) {
+        std::cerr << "  " << std::left << std::setw(28) << p.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << p.value / 1e6 << " ms";
+        if (p.calls > 1) std::cerr << "  (" << p.calls << " calls)";
+        std::cerr << std::endl;
+    }
+    for (_stats_entry& c : s.counters) {
+        std::cerr << "  " << std::left << std::setw(28) << c.name << std::right << std::setw(12) << c.value << std::endl;
+    }
+    std::cerr << "  " << std::left << std::setw(28) << "peak rss" << std::right << std::setw(12) << peakRSS << " KB" << std::endl;
+}
+
+void statsEnable(bool json) {
+    _stats_state& s = _stats();
+    s.json = json;
+    if (s.enabled) return;
+    s.enabled = true;
+    // reporting at exit also covers runs that bail out with an error part way through
+    std::atexit(_statsReport);
+}
+
+bool statsEnabled() {
+    return _stats().enabled;
+}
+
+void statsInit(int& argc, char** argv) {
+    const char* env = std::getenv("LEXPARSE_STATS");
+    if (env != nullptr && *env != '\0' && std::strcmp(env, "0") != 0) statsEnable(std::strcmp(env, "json") == 0);
+
+    int kept = 1;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--stats") statsEnable(false);
+        else if (arg == "--stats=json") statsEnable(true);
+        else argv[kept++] = argv[i];
+    }
+    argc = kept;
+    argv[argc] = nullptr;
+}
+
+void statsCount(const std::string& name, long long amount) {
+    _stats_state& s = _stats();
+    if (!s.enabled) return;
+    _stats_entry& e = _statsEntry(s.counters, s.counterIndex, name);
+    e.value += amount;
+    e.calls++;
+}
+
+void statsSet(const std::string& name, long long value) {
+    _stats_state& s = _stats();
+    if (!s.enabled) return;
+    _stats_entry& e = _statsEntry(s.counters, s.counterIndex, name);
+    e.value = value;
+    e.calls++;
+}
+
+StatsPhase::StatsPhase(const char* name) {
+    this->name = name;
+    this->active = _stats().enabled;
+    if (active) start = std::chrono::steady_clock::now();
+}
+
+StatsPhase::~StatsPhase() {
+    stop();
+}
+
+void StatsPhase::stop() {
+    if (!active) return;
+    active = false;
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    _stats_state& s = _stats();
+    _stats_entry& e = _statsEntry(s.phases, s.phaseIndex, name);
+    e.value += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    e.calls++;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+
+// opt-in run statistics: wall time per phase, named counters and peak RSS, printed to stderr
+// when the process exits. Enabled by a --stats / --stats=json argument or by setting the
+// LEXPARSE_STATS environment variable to "1" or "json"
+
+// removes any --stats arguments from argv so the caller's own argument handling never sees them
+void statsInit(int& argc, char** argv);
+void statsEnable(bool json);
+bool statsEnabled();
+
+// adds to a counter, or overwrites it with statsSet for values like sizes
+void statsCount(const std::string& name, long long amount = 1);
+void statsSet(const std::string& name, long long value);
+
+// times the enclosing scope, or until stop(), under `name`; repeated phases with the same name
+// accumulate
+class StatsPhase {
+    private:
+        const char* name;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+    public:
+        StatsPhase(const char* name);
+        ~StatsPhase();
+        void stop();
+};
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <unordered_map>
+#include <map>
+#include "tokenfile.h"
+
+void _writeVarint(std::string& out, uint64_t x) {
+    while (x >= 0x80) {
+        out.push_back((char)(x | 0x80));
+        x >>= 7;
+    }
+    out.push_back((char)x);
+}
+
+void _corruptTokenFile() {
+    std::cerr << "ERROR: binary token file is truncated or corrupt" << std::endl;
+    throw 1;
+}
+
+// reads a varint at pos, refusing to run past end
+uint64_t _readVarint(const char*& pos, const char* end) {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= end) break;
+        unsigned char b = *pos++;
+        x |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return x;
+    }
+    _corruptTokenFile();
+    return 0;
+}
+
+void writeBinaryTokenStream(std::ostream& stream, const std::vector<token>& tokenStream, LineIndex& lines) {
+    std::map<std::string, int> typeIds;
+    std::vector<std::string> types;
+    std::unordered_map<std::string, int> valueOffsets;
+    std::string blob;
+    std::string body;
+
+    int lastLine = 1;
+    for (const token& tok : tokenStream) {
+        auto typeItr = typeIds.find(tok.type);
+        if (typeItr == typeIds.end()) {
+            typeItr = typeIds.emplace(tok.type, types.size()).first;
+            types.push_back(tok.type);
+        }
+        auto valueItr = valueOffsets.find(tok.value);
+        if (valueItr == valueOffsets.end()) {
+            valueItr = valueOffsets.emplace(tok.value, blob.size()).first;
+            blob.append(tok.value);
+        }
+
+        int line = lines.line(tok.offset);
+        _writeVarint(body, typeItr->second);
+        _writeVarint(body, valueItr->second);
+        _writeVarint(body, tok.value.size());
+        _writeVarint(body, line - lastLine);
+        _writeVarint(body, lines.column(tok.offset));
+        lastLine = line;
+    }
+
+    std::string head(TOKEN_FILE_MAGIC);
+    head.push_back((char)TOKEN_FILE_VERSION);
+    _writeVarint(head, types.size());
+    for (std::string& type : types) {
+        _writeVarint(head, type.size());
+        head.append(type);
+    }
+    _writeVarint(head, blob.size());
+
+    std::string count;
+    _writeVarint(count, tokenStream.size());
+
+    stream.write(head.data(), head.size());
+    stream.write(blob.data(), blob.size());
+    stream.write(count.data(), count.size());
+    stream.write(body.data(), body.size());
+}
+
+// the version byte is a control character, which text token files never hold since values are
+// escaped, so a text file whose first token type starts with LTOK isn't taken for binary
+bool isBinaryTokenFile(std::string path) {
+    std::ifstream in(path, std::ios::binary);
+    char header[5];
+    if (!in.read(header, 5)) return false;
+    return memcmp(header, TOKEN_FILE_MAGIC, 4) == 0 && header[4] == TOKEN_FILE_VERSION;
+}
+
+TokenFileView::TokenFileView(std::string path) : file(path, "token file") {
+    data = file.view().data();
+    length = file.view().size();
+    if (length < 5 || memcmp(data, TOKEN_FILE_MAGIC, 4) != 0 || data[4] != TOKEN_FILE_VERSION) {
+        std::cerr << "ERROR: \"" << path << "\" is not a binary token file" << std::endl;
+        throw 1;
+    }
+
+    // every count and length is checked against the bytes left before it is used, and each
+    // type or token takes at least one byte per varint
+    const char* end = data + length;
+    const char* pos = data + 5;
+    uint64_t typeCount = _readVarint(pos, end);
+    if (typeCount > size_t(end - pos)) _corruptTokenFile();
+    for (uint64_t i = 0; i < typeCount; i++) {
+        uint64_t typeLength = _readVarint(pos, end);
+        if (typeLength > size_t(end - pos)) _corruptTokenFile();
+        types.push_back(std::string_view(pos, typeLength));
+        pos += typeLength;
+    }
+    uint64_t blobLength = _readVarint(pos, end);
+    if (blobLength > size_t(end - pos)) _corruptTokenFile();
+    blob = std::string_view(pos, blobLength);
+    pos += blobLength;
+    tokenCount = _readVarint(pos, end);
+    if (tokenCount > size_t(end - pos) / 5) _corruptTokenFile();
+
+    tokensStart = pos;
+    rewind();
+}
+
+size_t TokenFileView::size() {
+    return tokenCount;
+}
+
+size_t TokenFileView::typeCount() {
+    return types.size();
+}
+
+std::string_view TokenFileView::typeName(int typeId) {
+    return types[typeId];
+}
+
+void TokenFileView::rewind() {
+    cursor = tokensStart;
+    remaining = tokenCount;
+    line = 1;
+}
+
+bool TokenFileView::next(token_view& tok) {
+    if (remaining == 0) return false;
+    const char* end = data + length;
+
+    uint64_t type = _readVarint(cursor, end);
+    uint64_t valueOffset = _readVarint(cursor, end);
+    uint64_t valueLength = _readVarint(cursor, end);
+    uint64_t lineDelta = _readVarint(cursor, end);
+    uint64_t column = _readVarint(cursor, end);
+    if (type >= types.size() || valueOffset > blob.size() || valueLength > blob.size() - valueOffset
+        || lineDelta > INT_MAX - line || column > INT_MAX) {
+        _corruptTokenFile();
+    }
+    line += lineDelta;
+
+    tok.typeId = type;
+    tok.type = types[type];
+    tok.value = blob.substr(valueOffset, valueLength);
+    tok.line = line;
+    tok.column = column;
+    remaining--;
+    return true;
+}
+
+TokenFileSource::TokenFileSource(TokenFileView& view, const std::unordered_set<std::string>& skippedTypes) : view(view) {
+    for (int i = 0; i < view.typeCount(); i++) {
+        typeNames.push_back(std::string(view.typeName(i)));
+        skipped.push_back(skippedTypes.find(typeNames.back()) != skippedTypes.end());
+    }
+}
+
+const token* TokenFileSource::next() {
+    token_view tok;
+    while (view.next(tok)) {
+        if (skipped[tok.typeId]) continue;
+        current.type = typeNames[tok.typeId];
+        current.value.clear();
+        appendCleanSrcFormat(current.value, tok.value);
+        current.line = tok.line;
+        current.col = tok.column;
+        return &current;
+    }
+    return nullptr;
+}
+
+void TokenFileSource::rewind() {
+    view.rewind();
+}
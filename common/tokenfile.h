@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include "lexer.h"
+#include "mappedfile.h"
+
+// binary token stream, written by LUTHER --binary:
+//   "LTOK" and a version byte
+//   varint type count, then (varint length, bytes) per token type
+//   varint blob length, then the blob of token values, with identical values stored once
+//   varint token count, then per token varints for type id, value offset and length into the
+//   blob, line delta from the previous token and column
+const char TOKEN_FILE_MAGIC[] = "LTOK";
+const int TOKEN_FILE_VERSION = 1;
+
+void writeBinaryTokenStream(std::ostream& stream, const std::vector<token>& tokenStream, LineIndex& lines);
+bool isBinaryTokenFile(std::string path);
+
+struct token_view {
+    int typeId;               // index into the file's type table
+    std::string_view type;
+    std::string_view value;   // raw bytes, not escaped like the text format
+    int line;
+    int column;
+};
+
+// maps a binary token file into memory and iterates it without allocating per token
+class TokenFileView {
+    private:
+        MappedFile file;
+        const char* data = nullptr;
+        size_t length = 0;
+
+        std::vector<std::string_view> types;
+        std::string_view blob;
+        const char* tokensStart;
+        const char* cursor;
+        size_t tokenCount;
+        size_t remaining;
+        int line;
+
+    public:
+        TokenFileView(std::string path);
+        TokenFileView(const TokenFileView&) = delete;
+        TokenFileView& operator=(const TokenFileView&) = delete;
+
+        size_t size();
+        size_t typeCount();
+        std::string_view typeName(int typeId);
+        bool next(token_view& tok);
+        void rewind();
+};
+
+// hands the tokens of a binary file to the parser straight from the mapping. Values are escaped
+// the way the text format stores them into one token that's reused for every call, so nothing
+// is allocated per token once its buffers have grown
+class TokenFileSource : public TokenSource {
+    private:
+        TokenFileView& view;
+        std::vector<std::string> typeNames;
+        std::vector<char> skipped;  // by type id
+        token current;
+    public:
+        TokenFileSource(TokenFileView& view, const std::unordered_set<std::string>& skippedTypes = {});
+        const token* next() override;
+        void rewind();
+};
@@ -0,0 +1,60 @@
+#include "tokenqueue.h"
+
+TokenQueue::TokenQueue(int capacity, int chunkSize) {
+    this->capacity = capacity;
+    this->chunkSize = chunkSize;
+    pending.reserve(chunkSize);
+}
+
+bool TokenQueue::push(token tok) {
+    pending.push_back(std::move(tok));
+    if (pending.size() < chunkSize) return true;
+    return flush();
+}
+
+// hands the pending chunk to the consumer, waiting while the queue is full
+bool TokenQueue::flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    notFull.wait(guard, [&]() { return chunks.size() < capacity || abandoned; });
+    if (abandoned) return false;
+
+    chunks.push_back(std::move(pending));
+    pending = std::vector<token>();
+    pending.reserve(chunkSize);
+    notEmpty.notify_one();
+    return true;
+}
+
+void TokenQueue::close(int error) {
+    if (!pending.empty()) flush();
+
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    this->error = error;
+    notEmpty.notify_one();
+}
+
+const token* TokenQueue::next() {
+    if (currentPos < current.size()) return &current[currentPos++];
+
+    std::unique_lock<std::mutex> guard(lock);
+    notEmpty.wait(guard, [&]() { return !chunks.empty() || closed; });
+    if (chunks.empty()) {
+        if (error != 0) throw error;
+        return nullptr;
+    }
+
+    current = std::move(chunks.front());
+    chunks.pop_front();
+    currentPos = 0;
+    notFull.notify_one();
+    return &current[currentPos++];
+}
+
+// the consumer is done, so a producer blocked on a full queue is released and stops
+void TokenQueue::abandon() {
+    std::lock_guard<std::mutex> guard(lock);
+    abandoned = true;
+    chunks.clear();
+    notFull.notify_all();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "lexer.h"
+
+// bounded queue handing tokens from a producer thread to a consumer thread that pulls them as a
+// TokenSource. Tokens travel in chunks so the lock is taken once per chunk rather than per token
+class TokenQueue : public TokenSource {
+    private:
+        std::mutex lock;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::deque<std::vector<token>> chunks;
+        int capacity;
+        int chunkSize;
+        bool closed = false;
+        int error = 0;  // thrown to the consumer in place of the end of the stream
+        bool abandoned = false;
+
+        std::vector<token> pending;  // filled by the producer
+        std::vector<token> current;  // drained by the consumer
+        int currentPos = 0;
+        bool flush();
+
+    public:
+        TokenQueue(int capacity = 64, int chunkSize = 256);
+
+        // producer side: push returns false once the consumer has abandoned the queue. A producer
+        // that fails closes with its error code, so the consumer throws it instead of seeing the
+        // stream end early
+        bool push(token tok);
+        void close(int error = 0);
+
+        // consumer side
+        const token* next() override;
+        void abandon();
+};
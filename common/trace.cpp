@@ -0,0 +1,102 @@
+#ifdef LEXPARSE_TRACE
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <cstdlib>
+#include "trace.h"
+
+struct _trace_event {
+    const char* name;
+    long long startUs;
+    long long durationUs;
+    size_t thread;
+    char phase;       // 'X' for a finished scope, 'C' for a counter sample
+    long long value;  // counter samples only
+};
+
+struct _trace_state {
+    std::mutex lock;
+    std::vector<_trace_event> events;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+void _traceWrite();
+
+_trace_state& _trace() {
+    static _trace_state* state = []() {
+        // never destroyed, so scopes closing during static destruction still have somewhere to go
+        _trace_state* s = new _trace_state();
+        std::atexit(_traceWrite);
+        return s;
+    }();
+    return *state;
+}
+
+void _traceWrite() {
+    _trace_state& t = _trace();
+    std::lock_guard<std::mutex> guard(t.lock);
+
+    const char* path = std::getenv("LEXPARSE_TRACE_FILE");
+    std::ofstream out(path != nullptr && *path != '\0' ? path : "trace.json");
+    if (!out.good()) {
+        std::cerr << "ERROR: could not write trace file" << std::endl;
+        return;
+    }
+
+    // thread ids are hashed down to small numbers so the viewer labels them readably
+    std::vector<size_t> threads;
+    out << "{\"traceEvents\": [";
+    for (int i = 0; i < t.events.size(); i++) {
+        _trace_event& e = t.events[i];
+        int tid = 0;
+        while (tid < threads.size() && threads[tid] != e.thread) tid++;
+        if (tid == threads.size()) threads.push_back(e.thread);
+
+        out << (i > 0 ? ",\n" : "\n") << "{\"name\": \"" << e.name << "\", \"ph\": \"" << e.phase << "\", \"ts\": " << e.startUs;
+        if (e.phase == 'C') out << ", \"args\": {\"value\": " << e.value << "}";
+        else out << ", \"dur\": " << e.durationUs;
+        out << ", \"pid\": 1, \"tid\": " << tid + 1 << "}";
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\"}" << std::endl;
+}
+
+TraceScope::TraceScope(const char* name) {
+    this->name = name;
+    _trace();
+    this->start = std::chrono::steady_clock::now();
+}
+
+TraceScope::~TraceScope() {
+    auto end = std::chrono::steady_clock::now();
+    _trace_state& t = _trace();
+    _trace_event e;
+    e.name = name;
+    e.startUs = std::chrono::duration_cast<std::chrono::microseconds>(start - t.epoch).count();
+    e.durationUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    e.thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    e.phase = 'X';
+    e.value = 0;
+
+    std::lock_guard<std::mutex> guard(t.lock);
+    t.events.push_back(e);
+}
+
+void traceCounter(const char* name, long long value) {
+    _trace_state& t = _trace();
+    _trace_event e;
+    e.name = name;
+    e.startUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t.epoch).count();
+    e.durationUs = 0;
+    e.thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    e.phase = 'C';
+    e.value = value;
+
+    std::lock_guard<std::mutex> guard(t.lock);
+    t.events.push_back(e);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+// scoped trace events written as Chrome trace_event JSON, which chrome://tracing and Perfetto
+// load directly. Only compiled in when configured with -DLEXPARSE_TRACE=ON; otherwise
+// TRACE_SCOPE expands to nothing. The trace goes to the file named by LEXPARSE_TRACE_FILE
+// (default trace.json) when the process exits. TRACE_COUNTER records a sampled value on the
+// calling thread's track, for loops too hot to wrap every iteration in a scope
+
+#ifdef LEXPARSE_TRACE
+
+#include <chrono>
+
+class TraceScope {
+    private:
+        const char* name;
+        std::chrono::steady_clock::time_point start;
+    public:
+        TraceScope(const char* name);
+        ~TraceScope();
+};
+
+void traceCounter(const char* name, long long value);
+
+#define _TRACE_CONCAT2(a, b) a##b
+#define _TRACE_CONCAT(a, b) _TRACE_CONCAT2(a, b)
+// name must be a string literal or otherwise outlive the process
+#define TRACE_SCOPE(name) TraceScope _TRACE_CONCAT(_traceScope, __LINE__)(name)
+#define TRACE_COUNTER(name, value) traceCounter(name, value)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+
+#endif
@@ -5,7 +5,16 @@
 #include <algorithm>
 #include "serialization.h"
 
-inline int ParseTree::rootNode() {
+// drops all nodes but keeps the allocated storage so the tree can be rebuilt cheaply
+void ParseTree::clear() {
+    nodeCount = 0;
+    rootId = 0;
+}
+int ParseTree::size() {
+    return nodeCount;
+}
+
+int ParseTree::rootNode() {
     return rootId;
 }
 void ParseTree::setRoot(int rootId) {
@@ -17,36 +26,47 @@ std::vector<int>* ParseTree::getChildren(int nodeId) {
 }
 
 int ParseTree::getParent(int nodeId) {
-    return parentMap[nodeId];
+    return parents[nodeId];
 }
 
-inline int ParseTree::getLabel(int node) {
+int ParseTree::getLabel(int node) {
     return labels[node];
 }
 
 int ParseTree::addNode(int label, tree_metadata meta) {
+    int node = nodeCount;
+    nodeCount++;
+    if (node < adj.size()) {
+        // reuse a slot left over from before the last clear()
+        adj[node].clear();
+        parents[node] = -1;
+        labels[node] = label;
+        metadata[node].value.assign(meta.value);
+        return node;
+    }
     std::vector<int> empty;
     adj.push_back(empty);
+    parents.push_back(-1);
     labels.push_back(label);
     metadata.push_back(meta);
-    return adj.size() - 1;
+    return node;
 }
 
 void ParseTree::addChild(int parent, int child) {
     adj[parent].push_back(child);
-    parentMap[child] = parent;
+    parents[child] = parent;
 }
 
 void ParseTree::insertChild(int parent, int child, int pos) {
     adj[parent].insert(adj[parent].begin() + pos, child);
-    parentMap[child] = parent;
+    parents[child] = parent;
 }
 
 void ParseTree::removeChild(int parent, int child) {
     std::vector<int>& adjParent = adj[parent];
     
     adjParent.erase(std::remove(adjParent.begin(), adjParent.end(), child), adjParent.end());
-    parentMap.erase(child);
+    parents[child] = -1;
 }
 
 tree_metadata* ParseTree::getMetadata(int node) {
@@ -58,78 +78,164 @@ bool ParseTree::isLeaf(int node) {
 }
 
 
-void _printCount(std::stringstream &ss, std::string str, int count) {
-    for(int i=0; i<count; i++) {
-        ss << str;
-    }
+TreeWalker ParseTree::preorder(int node) {
+    return TreeWalker(this, node, PREORDER);
 }
-std::string ParseTree::toString() {
-    std::map<int, std::string> emptyMap;
-    return toString(emptyMap, rootNode(), 0);
+TreeWalker ParseTree::postorder(int node) {
+    return TreeWalker(this, node, POSTORDER);
 }
-std::string ParseTree::toString(std::map<int, std::string> labelMap) {
-    return toString(labelMap, rootNode(), 0);
+TreeWalker ParseTree::walk(int node) {
+    return TreeWalker(this, node, PREPOSTORDER);
 }
-std::string ParseTree::toString(std::map<int, std::string> labelMap, int node, int level) {
-    std::stringstream ss;
 
-    for (int i=0; i<adj[node].size(); i++) {
-        int n = adj[node][i];
-        int nl = labels[n];
-        _printCount(ss, "  ", level);
-        if (labelMap.find(nl) != labelMap.end()) {
-            ss << labelMap[nl] << std::endl;
-        }
-        else {
-            ss << nl << std::endl;
+
+TreeWalker::TreeWalker(ParseTree* tree, int root, TraversalOrder order) {
+    this->tree = tree;
+    this->visitEnter = order != POSTORDER;
+    this->visitLeave = order != PREORDER;
+    stack.push_back({ root, -1, 0, -1 });
+}
+
+bool TreeWalker::next(tree_visit& visit) {
+    while (stack.size() > 0) {
+        frame& top = stack.back();
+        if (top.nextChild == -1) {
+            top.nextChild = 0;
+            if (visitEnter) {
+                visit = { top.node, top.parent, top.depth, false };
+                return true;
+            }
+            continue;
         }
 
-        if (!isLeaf(n)) {
-            _printCount(ss, "  ", level);
-            ss << "(" << std::endl;
-            ss << toString(labelMap, n, level+1);
-            _printCount(ss, "  ", level);
-            ss << ")" << std::endl;
+        std::vector<int>* children = tree->getChildren(top.node);
+        if (top.nextChild < children->size()) {
+            int child = children->at(top.nextChild);
+            top.nextChild++;
+            // top is invalidated by the push below
+            stack.push_back({ child, top.node, top.depth + 1, -1 });
+            continue;
         }
+
+        visit = { top.node, top.parent, top.depth, true };
+        stack.pop_back();
+        if (visitLeave) return true;
     }
+    return false;
+}
 
-    return ss.str();
+TreeWalker::iterator TreeWalker::begin() {
+    return iterator(this);
+}
+TreeWalker::iterator TreeWalker::end() {
+    return iterator(nullptr);
+}
+
+TreeWalker::iterator::iterator(TreeWalker* walker) {
+    this->walker = walker;
+    if (walker != nullptr) ++(*this);
+}
+const tree_visit& TreeWalker::iterator::operator*() const {
+    return current;
+}
+TreeWalker::iterator& TreeWalker::iterator::operator++() {
+    if (!walker->next(current)) walker = nullptr;
+    return *this;
+}
+bool TreeWalker::iterator::operator!=(const iterator& other) const {
+    return walker != other.walker;
 }
 
-void _gvRecurse(std::ostream& os, ParseTree *tree, std::map<int, std::string> &labelMap, int node, int *idx) {
-    os << "n" << *idx << " [label=\"";
-    os << labelMap[tree->getLabel(node)];
-    std::string metaval = tree->getMetadata(node)->value;
-    if (metaval.size() > 0) {
-        os << " (" << metaval << ")" << std::endl;
+
+void _printIndent(std::ostream &os, int count) {
+    for(int i=0; i<count; i++) {
+        os << "  ";
+    }
+}
+void _printLabel(std::ostream &os, const std::map<int, std::string>& labelMap, int label) {
+    auto itr = labelMap.find(label);
+    if (itr != labelMap.end()) {
+        os << itr->second;
     }
-    os << "\"] ;" << std::endl;
-    int parentIdx = *idx;
-    (*idx)++;
-    int childIdx;
-
-    for (int child : *tree->getChildren(node)) {
-        childIdx = *idx;
-        _gvRecurse(os, tree, labelMap, child, idx);
-        os << "n" << parentIdx << " -- " << "n" << childIdx << " ;" << std::endl;
+    else {
+        os << label;
+    }
+}
+std::string ParseTree::toString() {
+    std::map<int, std::string> emptyMap;
+    return toString(emptyMap, rootNode(), 0);
+}
+std::string ParseTree::toString(const std::map<int, std::string>& labelMap) {
+    return toString(labelMap, rootNode(), 0);
+}
+std::string ParseTree::toString(const std::map<int, std::string>& labelMap, int node, int level) {
+    std::stringstream ss;
+    write(ss, labelMap, node, level);
+    return ss.str();
+}
+void ParseTree::write(std::ostream& os, const std::map<int, std::string>& labelMap) {
+    write(os, labelMap, rootNode(), 0);
+}
+void ParseTree::write(std::ostream& os, const std::map<int, std::string>& labelMap, int node, int level) {
+    // the starting node itself isn't printed, only its descendants, each nested one level deeper
+    for (const tree_visit& visit : walk(node)) {
+        if (visit.depth == 0) continue;
+        int indent = level + visit.depth - 1;
+
+        if (!visit.leaving) {
+            _printIndent(os, indent);
+            _printLabel(os, labelMap, labels[visit.node]);
+            os << '\n';
+            if (!isLeaf(visit.node)) {
+                _printIndent(os, indent);
+                os << "(\n";
+            }
+        }
+        else if (!isLeaf(visit.node)) {
+            _printIndent(os, indent);
+            os << ")\n";
+        }
     }
 }
 
-std::string ParseTree::toGraphviz(std::map<int, std::string> labelMap) {
+std::string ParseTree::toGraphviz(const std::map<int, std::string>& labelMap) {
     std::ostringstream oss;
+    writeGraphviz(oss, labelMap);
+    return oss.str();
+}
 
+void ParseTree::writeGraphviz(std::ostream& os, const std::map<int, std::string>& labelMap) {
     // print out the preamble
-    oss << "graph \"\"" << std::endl;
-    oss << "{" << std::endl;
-    oss << "fontname=\"Monospace\"" << std::endl;
-    oss << "node [fontname=\"Monospace\"]" << std::endl;
-    oss << "edge [fontname=\"Monospace\"]" << std::endl;
-    oss << std::endl;
+    os << "graph \"\"\n";
+    os << "{\n";
+    os << "fontname=\"Monospace\"\n";
+    os << "node [fontname=\"Monospace\"]\n";
+    os << "edge [fontname=\"Monospace\"]\n";
+    os << "\n";
+
+    // graphviz ids are handed out in preorder, edges are written once the child's subtree is done
+    std::vector<int> gvIds(nodeCount, 0);
+    int nextId = 0;
+    for (const tree_visit& visit : walk(rootNode())) {
+        if (visit.leaving) {
+            if (visit.parent != -1) {
+                os << "n" << gvIds[visit.parent] << " -- " << "n" << gvIds[visit.node] << " ;\n";
+            }
+            continue;
+        }
 
-    int _idx = 0;
-    _gvRecurse(oss, this, labelMap, rootNode(), &_idx);
+        gvIds[visit.node] = nextId;
+        nextId++;
 
-    oss << "}" << std::endl;
+        os << "n" << gvIds[visit.node] << " [label=\"";
+        auto labelItr = labelMap.find(labels[visit.node]);
+        if (labelItr != labelMap.end()) os << labelItr->second;
+        std::string& metaval = metadata[visit.node].value;
+        if (metaval.size() > 0) {
+            os << " (" << metaval << ")\n";
+        }
+        os << "\"] ;\n";
+    }
 
-    return oss.str();
+    os << "}" << std::endl;
 }
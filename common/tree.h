@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <ostream>
 #include <cstdint>
 
 
@@ -12,15 +13,25 @@ struct tree_metadata {
 
 const tree_metadata EMPTY_METADATA;
 
+class TreeWalker;
+
+enum TraversalOrder {
+    PREORDER,       // nodes are visited on the way down
+    POSTORDER,      // nodes are visited on the way back up
+    PREPOSTORDER    // both, with visit.leaving telling them apart
+};
 
 class ParseTree {
     private:
         int rootId = 0;
+        int nodeCount = 0;  // live nodes; storage past this index is kept for reuse
         std::vector<std::vector<int>> adj;
-        std::map<int, int> parentMap; // to make parent search quick
+        std::vector<int> parents; // to make parent search quick
         std::vector<int> labels;
         std::vector<tree_metadata> metadata;
     public:
+        void clear();
+        int size();
         int rootNode();
         void setRoot(int rootId);
         std::vector<int>* getChildren(int nodeId);
@@ -32,8 +43,54 @@ class ParseTree {
         void removeChild(int parent, int child);
         tree_metadata* getMetadata(int node);
         bool isLeaf(int node);
+        TreeWalker preorder(int node);
+        TreeWalker postorder(int node);
+        TreeWalker walk(int node);
         std::string toString();
-        std::string toString(std::map<int, std::string> labelMap);
-        std::string toString(std::map<int, std::string> labelMap, int node, int level);
-        std::string toGraphviz(std::map<int, std::string> labelMap);
+        std::string toString(const std::map<int, std::string>& labelMap);
+        std::string toString(const std::map<int, std::string>& labelMap, int node, int level);
+        void write(std::ostream& os, const std::map<int, std::string>& labelMap);
+        void write(std::ostream& os, const std::map<int, std::string>& labelMap, int node, int level);
+        std::string toGraphviz(const std::map<int, std::string>& labelMap);
+        void writeGraphviz(std::ostream& os, const std::map<int, std::string>& labelMap);
+};
+
+struct tree_visit {
+    int node;
+    int parent;   // -1 for the node the walk started from
+    int depth;    // 0 for the node the walk started from
+    bool leaving;
+};
+
+// walks a subtree with an explicit stack instead of recursion, so arbitrarily deep trees
+// can be traversed without running out of call stack
+class TreeWalker {
+    private:
+        struct frame {
+            int node;
+            int parent;
+            int depth;
+            int nextChild;  // -1 until the node has been entered
+        };
+
+        ParseTree* tree;
+        bool visitEnter;
+        bool visitLeave;
+        std::vector<frame> stack;
+    public:
+        class iterator {
+            private:
+                TreeWalker* walker;
+                tree_visit current;
+            public:
+                iterator(TreeWalker* walker);
+                const tree_visit& operator*() const;
+                iterator& operator++();
+                bool operator!=(const iterator& other) const;
+        };
+
+        TreeWalker(ParseTree* tree, int root, TraversalOrder order);
+        bool next(tree_visit& visit);
+        iterator begin();
+        iterator end();
 };
@@ -0,0 +1,137 @@
+#include <sstream>
+#include <random>
+#include <functional>
+#include "workload.h"
+
+std::string blowupRegex(int n) {
+    std::string regex = "(a|b)*a";
+    for (int i = 0; i < n; i++) regex += "(a|b)";
+    return regex;
+}
+
+Definition blowupDefinition(int n) {
+    Definition def;
+    def.head.alphabet = {'a', 'b'};
+    def.head.lambda = _unusedCharacter(def.head.alphabet);
+    def.head.stateCount = n + 2;
+
+    auto addLine = [&](bool accepting, int from, int to, std::vector<char> chars) {
+        DefinitionLine line;
+        line.accepting = accepting;
+        line.from = from;
+        line.to = to;
+        line.transitionCharacters = chars;
+        def.lines.push_back(line);
+    };
+    addLine(false, 0, 0, {'a', 'b'});
+    addLine(false, 0, 1, {'a'});
+    for (int i = 1; i <= n; i++) addLine(false, i, i + 1, {'a', 'b'});
+    addLine(true, n + 1, n + 1, {});
+    return def;
+}
+
+// keywords are spelled in base 25 over the letters other than x, behind a k so none is empty
+std::string keywordName(int i) {
+    const std::string letters = "abcdefghijklmnopqrstuvwyz";
+    std::string name = "k";
+    do {
+        name.push_back(letters[i % letters.size()]);
+        i /= letters.size();
+    } while (i > 0);
+    return name;
+}
+
+workload_tokens keywordTokens(int keywords) {
+    workload_tokens def;
+    for (char c : std::string("0123456789LPRSWabcdefghijklmnopqrstuvwyz")) def.alphabet.push_back(c);
+
+    // keywords come first so they win ties with identifiers
+    for (int i = 0; i < keywords; i++) def.tokens.push_back({keywordName(i), "kw" + std::to_string(i)});
+    def.tokens.push_back({"W+", "ws"});
+    def.tokens.push_back({"a-z(a-z|0-9)*", "id"});
+    def.tokens.push_back({"0-9+", "num"});
+    def.tokens.push_back({"P", "plus"});
+    def.tokens.push_back({"L", "lp"});
+    def.tokens.push_back({"R", "rp"});
+    def.tokens.push_back({"S", "semi"});
+    return def;
+}
+
+std::string formatTokenConfig(const workload_tokens& def) {
+    std::stringstream ss;
+    for (char c : def.alphabet) ss << c;
+    ss << std::endl;
+    for (const workload_token& tok : def.tokens) ss << tok.regex << " " << tok.name << std::endl;
+    return ss.str();
+}
+
+std::string keywordGrammar(int keywords) {
+    std::stringstream ss;
+    ss << "PROG -> STMTS $" << std::endl;
+    ss << "STMTS -> STMT STMTS | lambda" << std::endl;
+    ss << "STMT ->";
+    for (int i = 0; i < keywords; i++) {
+        if (i > 0) ss << " |";
+        ss << " kw" << i << " EXPR semi";
+    }
+    ss << std::endl;
+    ss << "EXPR -> TERM EXPRT" << std::endl;
+    ss << "EXPRT -> plus TERM EXPRT | lambda" << std::endl;
+    ss << "TERM -> id | num | lp EXPR rp" << std::endl;
+    return ss.str();
+}
+
+// (type, text) pairs of a random program, generated once for both the source and token forms
+std::vector<std::pair<std::string, std::string>> _keywordProgram(int keywords, int statements, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::pair<std::string, std::string>> program;
+
+    auto identifier = [&]() {
+        // identifiers end in a digit, so they never spell a keyword
+        std::string name = keywordName(rng() % 1000);
+        name.push_back('a' + rng() % 5);
+        name.push_back('0' + rng() % 10);
+        return name;
+    };
+    std::function<void(int)> expr = [&](int depth) {
+        int terms = 1 + rng() % 3;
+        for (int i = 0; i < terms; i++) {
+            if (i > 0) program.push_back({"plus", "P"});
+            int kind = rng() % 4;
+            if (kind == 0 && depth < 3) {
+                program.push_back({"lp", "L"});
+                expr(depth + 1);
+                program.push_back({"rp", "R"});
+            }
+            else if (kind == 1) program.push_back({"num", std::to_string(rng() % 100000)});
+            else program.push_back({"id", identifier()});
+        }
+    };
+
+    for (int i = 0; i < statements; i++) {
+        int keyword = keywords > 0 ? rng() % keywords : 0;
+        program.push_back({"kw" + std::to_string(keyword), keywordName(keyword)});
+        expr(0);
+        program.push_back({"semi", "S"});
+    }
+    return program;
+}
+
+std::string keywordSource(int keywords, int statements, unsigned int seed) {
+    std::string source;
+    for (auto& tok : _keywordProgram(keywords, statements, seed)) {
+        if (!source.empty()) source.push_back('W');
+        source.append(tok.second);
+    }
+    return source;
+}
+
+std::vector<token> keywordTokenStream(int keywords, int statements, unsigned int seed) {
+    std::vector<token> tokens;
+    int offset = 0;
+    for (auto& tok : _keywordProgram(keywords, statements, seed)) {
+        tokens.push_back(create_token(tok.first, tok.second, offset));
+        offset += tok.second.size() + 1;
+    }
+    return tokens;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "nfa.h"
+#include "lexer.h"
+
+// deterministic synthetic inputs shared by the BENCH and GEN tools
+
+// (a|b)*a followed by n copies of (a|b): any DFA for it needs 2^(n+1) states
+std::string blowupRegex(int n);
+// the same language as a lambda-free NFA definition over {a, b} with n + 2 states
+Definition blowupDefinition(int n);
+
+// a scanner over digits, lowercase letters (no x) and the operator letters L, P, R, S, W with
+// `keywords` keyword tokens ahead of identifiers, numbers, operators and whitespace
+struct workload_token {
+    std::string regex;
+    std::string name;
+};
+
+struct workload_tokens {
+    std::vector<char> alphabet;
+    std::vector<workload_token> tokens;
+};
+
+std::string keywordName(int i);
+workload_tokens keywordTokens(int keywords);
+std::string formatTokenConfig(const workload_tokens& def);
+
+// LL(1) grammar for keywordTokens with one statement production per keyword
+std::string keywordGrammar(int keywords);
+
+// a program of `statements` statements in that language, as source text for the scanner or as
+// the whitespace-free token stream the scanner produces from it
+std::string keywordSource(int keywords, int statements, unsigned int seed);
+std::vector<token> keywordTokenStream(int keywords, int statements, unsigned int seed);
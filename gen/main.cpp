@@ -0,0 +1,101 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include <common/nfa.h>
+#include <common/lexer.h>
+#include <common/lines.h>
+#include <common/workload.h>
+
+void printHelp() {
+    std::cout << "USAGE:" << std::endl;
+    std::cout << "\tGEN nfa N OUTPUT_PATH\t\t\tNFA definition for (a|b)*a(a|b){N}, whose DFA has 2^(N+1) states" << std::endl;
+    std::cout << "\tGEN tokens KEYWORDS OUTPUT_PATH\t\tWRECK config with KEYWORDS keyword tokens" << std::endl;
+    std::cout << "\tGEN grammar KEYWORDS OUTPUT_PATH\tLL(1) grammar over those tokens" << std::endl;
+    std::cout << "\tGEN source KEYWORDS STATEMENTS OUTPUT_PATH [--seed S]\tprogram for LUTHER" << std::endl;
+    std::cout << "\tGEN stream KEYWORDS STATEMENTS OUTPUT_PATH [--seed S]\ttoken stream for LGA" << std::endl;
+}
+
+int _count(const std::string& arg, const std::string& what) {
+    try {
+        size_t used;
+        int value = std::stoi(arg, &used);
+        if (used == arg.size() && value >= 0) return value;
+    } catch (std::exception&) {}
+    std::cerr << "ERROR: expected a non-negative " << what << " but got '" << arg << "'" << std::endl;
+    throw 1;
+}
+
+int main(int argc, char** argv) {
+    // flags may appear anywhere, everything else is positional
+    std::string seedArg = "1";
+    std::vector<std::string> args;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) seedArg = argv[++i];
+        else args.push_back(arg);
+    }
+
+    if (args.size() < 1) {
+        std::cerr << "ERROR: expected input kind in argument 1" << std::endl;
+        printHelp();
+        return 1;
+    }
+    std::string kind = args[0];
+    bool program = kind == "source" || kind == "stream";
+    if (kind != "nfa" && kind != "tokens" && kind != "grammar" && !program) {
+        std::cerr << "ERROR: unknown input kind '" << kind << "'" << std::endl;
+        printHelp();
+        return 1;
+    }
+    if (args.size() < (program ? 4 : 3)) {
+        std::cerr << "ERROR: expected " << (program ? "KEYWORDS STATEMENTS OUTPUT_PATH" : "size and OUTPUT_PATH")
+                  << " after '" << kind << "'" << std::endl;
+        printHelp();
+        return 1;
+    }
+
+    try {
+        int size = _count(args[1], kind == "nfa" ? "N" : "keyword count");
+        int statements = program ? _count(args[2], "statement count") : 0;
+        unsigned int seed = _count(seedArg, "seed");
+        // every statement starts with a keyword, so grammars and programs need at least one
+        if ((kind == "grammar" || program) && size == 0) {
+            std::cerr << "ERROR: expected at least one keyword for GEN " << kind << std::endl;
+            printHelp();
+            return 1;
+        }
+        std::string outputPath = args[program ? 3 : 2];
+
+        std::ofstream out(outputPath);
+        if (!out.good()) {
+            std::cerr << "ERROR: could not open output file \"" << outputPath << "\"" << std::endl;
+            return 1;
+        }
+
+        if (kind == "nfa") {
+            Definition def = blowupDefinition(size);
+            writeDefinition(out, def);
+        }
+        else if (kind == "tokens") {
+            out << formatTokenConfig(keywordTokens(size));
+        }
+        else if (kind == "grammar") {
+            out << keywordGrammar(size);
+        }
+        else if (kind == "source") {
+            out << keywordSource(size, statements, seed);
+        }
+        else {
+            // token values never contain newlines, so the offsets index a single line
+            std::string source = keywordSource(size, statements, seed);
+            LineIndex lines(source);
+            printTokenStream(out, keywordTokenStream(size, statements, seed), lines);
+        }
+    } catch (int e) {
+        return e;
+    }
+
+    return 0;
+}
@@ -1,28 +1,85 @@
 #include <iostream>
 #include <fstream>
+#include <unordered_set>
 
 #include <common/serialization.h>
 #include <common/cfg.h>
 #include <common/lexer.h>
+#include <common/tokenfile.h>
+#include <common/stats.h>
 
 
+// prints the token line that precedes the parse, returning how many tokens there were
+int _printTokens(TokenSource& source) {
+    int count = 0;
+    while (const token* t = source.next()) {
+        std::cout << "(" << t->type << "," << t->value << "), ";
+        count++;
+    }
+    std::cout << std::endl;
+    return count;
+}
+
 int main(int argc, char** argv) {
-    std::ifstream cfgStream(argv[1]);
+    // --stats[=json] may be given anywhere to report phase timings on stderr
+    statsInit(argc, argv);
+
+    // --skip TYPE drops a token type while reading, e.g. whitespace from LUTHER --binary output
+    std::unordered_set<std::string> skippedTypes;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--skip" && i + 1 < argc) skippedTypes.insert(argv[++i]);
+        else args.push_back(arg);
+    }
+    if (args.size() != 3) {
+        std::cerr << "ERROR: usage: LGA GRAMMAR TOKENS TREE [--skip TYPE]..." << std::endl;
+        return 1;
+    }
+
+    StatsPhase grammarPhase("read grammar");
+    std::ifstream cfgStream(args[0]);
     CFG cfg = CFG::parse(cfgStream);
+    grammarPhase.stop();
 
+    StatsPhase grammarOutputPhase("output");
     std::cout << cfg.formatForLGA() << std::endl;
+    grammarOutputPhase.stop();
 
-    std::vector<token> tokens = readTokenFile(argv[2]);
-    for (token t : tokens) {
-        std::cout << "(" << t.type << "," << t.value << "), ";
+    // binary token files are parsed straight from the mapping, text ones are read in first
+    ParseSession session;
+    bool accepted;
+    if (isBinaryTokenFile(args[1])) {
+        TokenFileView view(args[1]);
+        TokenFileSource source(view, skippedTypes);
+
+        StatsPhase tokenOutputPhase("output");
+        statsSet("tokens", _printTokens(source));
+        tokenOutputPhase.stop();
+
+        source.rewind();
+        StatsPhase parsePhase("parse");
+        accepted = cfg.match(session, source);
     }
-    std::cout << std::endl;
+    else {
+        StatsPhase tokenPhase("read tokens");
+        session.tokens = readTokenFile(args[1], skippedTypes);
+        tokenPhase.stop();
+
+        StatsPhase tokenOutputPhase("output");
+        VectorTokenSource source(session.tokens);
+        statsSet("tokens", _printTokens(source));
+        tokenOutputPhase.stop();
+
+        StatsPhase parsePhase("parse");
+        accepted = cfg.match(session);
+    }
+    statsSet("tree nodes", session.tree.size());
 
-    std::pair<bool, ParseTree> matchResults = cfg.match(tokens);
-    // std::pair<bool, ParseTree> matchResults = cfg.match("oparen mult two three cparen");
-    std::cout << "MATCH: " << (matchResults.first ? "TRUE" : "FALSE") << std::endl;
-    cfg.printParseTree(matchResults.second);
-    cfg.saveGraphvizTree(argv[3], matchResults.second);
+    StatsPhase outputPhase("output");
+    std::cout << "MATCH: " << (accepted ? "TRUE" : "FALSE") << std::endl;
+    cfg.printParseTree(session.tree);
+    cfg.saveGraphvizTree(args[2], session.tree);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -4,117 +4,54 @@
 #include <vector>
 #include <common/serialization.h>
 #include <common/lexer.h>
-
-struct toktable {
-    std::string path;
-    std::string token;
-    std::string data;  // defaults to empty string if data should be matched token
-};
-
-struct tokdefs {
-    std::vector<char> alphabet;
-    std::vector<toktable> tables;
-};
-
-tokdefs readTokenDefinitions(std::string path) {
-    std::ifstream defFile(path);
-    if (!defFile.good()) {
-        std::cerr << "ERROR: cannot access token definition at \"" << path << "\"" << std::endl;
-        throw 1;
-    }
-
-    std::string alphabetDef;
-    getline(defFile, alphabetDef);
-
-    std::vector<char> alphabet;
-    for (int i=0; i<alphabetDef.size(); i++) {
-        char c = alphabetDef.at(i);
-        if (c == ' ') continue;
-        if (c == 'x') {
-            char d2 = alphabetDef.at(i+1);
-            char d1 = alphabetDef.at(i+2);
-            i+=2;
-
-            int x;   
-            std::stringstream ss;
-            ss << std::hex << d2 << d1;
-            ss >> x;
-
-            alphabet.push_back((char)x);
-        }
-        else {
-            alphabet.push_back(c);
-        }
-    }
-
-    std::vector<toktable> tables;
-    std::string line;
-    while (std::getline(defFile, line))
-    {
-        std::istringstream iss(line);
-        
-        std::string tableFile;
-        std::string tokenName;
-        std::string tokenData;
-        iss >> tableFile;
-        iss >> tokenName;
-        iss >> tokenData;
-        if(tableFile.size() == 0 || tokenName.size() == 0) continue;
-
-        toktable tab;
-        tab.path = tableFile;
-        tab.token = tokenName;
-        tab.data = readHexASCII(tokenData);
-        tables.push_back(tab);
-    }
-
-    defFile.close();
-
-    tokdefs def;
-    def.alphabet = alphabet;
-    def.tables = tables;
-    return def;
-}
+#include <common/tokenfile.h>
+#include <common/stats.h>
 
 void printHelp() {
     std::cout << "USAGE:" << std::endl;
-    std::cout << "\tLUTHER [DEFINITION_PATH] [PROGRAM_SRC] [TOKEN_OUTPUT_PATH]" << std::endl;
+    std::cout << "\tLUTHER [DEFINITION_PATH] [PROGRAM_SRC] [TOKEN_OUTPUT_PATH] [--binary] [--stats[=json]]" << std::endl;
+    std::cout << "\t--binary\twrite the compact binary token format instead of text" << std::endl;
+    std::cout << "\t--stats[=json]\treport phase timings, token counts and peak memory on stderr" << std::endl;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
+    statsInit(argc, argv);
+
+    // flags may appear anywhere, everything else is positional
+    bool binary = false;
+    std::vector<std::string> args;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--binary") binary = true;
+        else args.push_back(arg);
+    }
+
+    if (args.size() < 1) {
         std::cerr << "ERROR: expected lexer token definition file path in argument 1" << std::endl;
         printHelp();
         return 1;
     }
-    if (argc < 3) {
+    if (args.size() < 2) {
         std::cerr << "ERROR: expected program source file path in argument 2" << std::endl;
         printHelp();
         return 1;
     }
-    if (argc < 4) {
+    if (args.size() < 3) {
         std::cerr << "ERROR: expected token output file path in argument 3" << std::endl;
         printHelp();
         return 1;
     }
 
-    std::string defFile = argv[1];
-    std::string srcFile = argv[2];
-    std::string tokFile = argv[3];
+    std::string defFile = args[0];
+    std::string srcFile = args[1];
+    std::string tokFile = args[2];
 
     try {
-        tokdefs def = readTokenDefinitions(defFile);
-        std::vector<DFA> dfas;
-        std::vector<std::string> tokens;
-        std::vector<std::string> tokenData;
-        for (toktable tab : def.tables) {
-            DFA dfa = DFA::readTableFromAssignmentOutput(tab.path, def.alphabet);
-            dfas.push_back(dfa);
-            tokens.push_back(tab.token);
-            tokenData.push_back(tab.data);
-        }
+        StatsPhase loadPhase("load scanner");
+        Lexer lex = Lexer::fromDefinitions(readTokenDefinitions(defFile));
+        loadPhase.stop();
 
-        Lexer lex(def.alphabet, dfas, tokens, tokenData);
+        StatsPhase readPhase("read source");
         std::ifstream srcStream(srcFile);
         if (!srcStream.good()) {
             std::cerr << "ERROR: could not access program source file \"" << srcFile << "\"" << std::endl;
@@ -122,14 +59,24 @@ int main(int argc, char** argv) {
         }
         std::stringstream srcBuf;
         srcBuf << srcStream.rdbuf();
-        std::vector<token> tokenStream = lex.tokenize(srcBuf.str());
+        std::string src = srcBuf.str();
+        readPhase.stop();
+        statsSet("source bytes", src.size());
+
+        StatsPhase lexPhase("lex");
+        std::vector<token> tokenStream = lex.tokenize(src);
+        lexPhase.stop();
+        statsSet("tokens", tokenStream.size());
 
-        std::ofstream tokenOutput(tokFile);
+        StatsPhase outputPhase("output");
+        std::ofstream tokenOutput(tokFile, binary ? std::ios::binary : std::ios::out);
         if (!tokenOutput.good()) {
             std::cerr << "ERROR: could not access token output file \"" << tokFile << "\"" << std::endl;
             throw 1;
         }
-        printTokenStream(tokenOutput, tokenStream);
+        LineIndex lines(src);
+        if (binary) writeBinaryTokenStream(tokenOutput, tokenStream, lines);
+        else printTokenStream(tokenOutput, tokenStream, lines);
         tokenOutput.close();
     } catch(int e) {
         return e;
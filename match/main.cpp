@@ -1,61 +1,195 @@
 #include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <optional>
 
 #include <common/serialization.h>
 #include <common/nfa.h>
+#include <common/search.h>
+#include <common/mappedfile.h>
+#include <common/stats.h>
+#include <common/codegen.h>
 
 void printHelp() {
     std::cout << "USAGE:" << std::endl;
-    std::cout << "\tNFAMATCH [DEFINITION_PATH] [DFA_OUTPUT_PATH] [MATCH_STRINGS...]" << std::endl;
+    std::cout << "\tNFAMATCH [DEFINITION_PATH] [DFA_OUTPUT_PATH] [MATCH_STRINGS...] [--search FILE] [--max-states N] [--max-bytes N] [--fallback] [--emit-direct FILE] [--reorder] [--reorder-profile FILE] [--stats[=json]]" << std::endl;
+    std::cout << "\t--search FILE\tprint the [start, end) span of every match inside FILE" << std::endl;
+    std::cout << "\t--max-states N\tgive up on subset construction, or building the --search automaton, past N states" << std::endl;
+    std::cout << "\t--max-bytes N\tthe same for about N bytes of automaton states" << std::endl;
+    std::cout << "\t--fallback\tsimulate the NFA when a limit is hit instead of failing; no DFA table is written. A --search automaton over the limit falls back to matching the DFA at each candidate position" << std::endl;
+    std::cout << "\t--emit-direct FILE\twrite the minimized DFA as a direct-coded C++ matcher" << std::endl;
+    std::cout << "\t--reorder\trenumber DFA states breadth-first from the start after minimization" << std::endl;
+    std::cout << "\t--reorder-profile FILE\trenumber DFA states hottest first, by how often matching each line of FILE visits them" << std::endl;
+    std::cout << "\t--stats[=json]\treport phase timings, automaton sizes and peak memory on stderr" << std::endl;
 }
 
 int main(int argc, char** argv) {
-    if(argc < 2) {
+    statsInit(argc, argv);
+
+    // flags may appear anywhere, everything else is positional
+    std::string searchFile;
+    dfa_limits limits;
+    bool fallback = false;
+    std::string directFile;
+    bool reorder = false;
+    std::string profileFile;
+    std::vector<std::string> args;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--search" && i + 1 < argc) searchFile = argv[++i];
+        else if ((arg == "--max-states" || arg == "--max-bytes") && i + 1 < argc) {
+            size_t limit;
+            if (!parseLimit(argv[++i], limit)) {
+                std::cerr << "ERROR: expected a non-negative number after " << arg << std::endl;
+                return 1;
+            }
+            if (arg == "--max-states") limits.maxStates = limit;
+            else limits.maxBytes = limit;
+        }
+        else if (arg == "--fallback") fallback = true;
+        else if (arg == "--emit-direct" && i + 1 < argc) directFile = argv[++i];
+        else if (arg == "--reorder") reorder = true;
+        else if (arg == "--reorder-profile" && i + 1 < argc) profileFile = argv[++i];
+        else args.push_back(arg);
+    }
+
+    if(args.size() < 1) {
         std::cout << "ERROR: expected NFA definition file path in argument 1" << std::endl;
         printHelp();
         return 1;
     }
-    if(argc < 3) {
+    if(args.size() < 2) {
         std::cout << "ERROR: expected DFA definition output file path in argument 2" << std::endl;
         printHelp();
         return 1;
     }
     std::vector<std::string> matchCases;
-    for(int i=3; i<argc; i++) {
-        matchCases.push_back(argv[i]);
+    for(int i=2; i<args.size(); i++) {
+        matchCases.push_back(args[i]);
     }
-    std::string nfaFile = argv[1];
-    std::string dfaFile = argv[2];
+    std::string nfaFile = args[0];
+    std::string dfaFile = args[1];
 
     Definition nfaDef;
     try {
+        StatsPhase phase("read definition");
         nfaDef = readDefinition(nfaFile);
     } catch(int code) {
         return code;
     }
+    statsSet("nfa states", nfaDef.head.stateCount);
 
+    // without a DFA every query below is answered by simulating the NFA instead
+    StatsPhase subsetPhase("subset construction");
     NFA nfa(nfaDef);
-    DFA dfa = nfa.toDFA();
-    dfa.optimize();
+    std::optional<DFA> dfa;
+    try {
+        dfa = nfa.toDFA(limits);
+    } catch(int code) {
+        if (code != 4 || !fallback) return code;
+        std::cerr << "WARNING: falling back to NFA simulation, no DFA table will be written" << std::endl;
+    }
+    subsetPhase.stop();
+
+    if (dfa.has_value()) {
+        statsSet("dfa states", dfa->stateCount());
+        StatsPhase minimizePhase("minimization");
+        dfa->optimize();
+        minimizePhase.stop();
+        statsSet("minimized dfa states", dfa->stateCount());
+
+        if (profileFile.size() > 0) {
+            std::ifstream profileStream(profileFile);
+            if (!profileStream.good()) {
+                std::cerr << "ERROR: could not access profile file \"" << profileFile << "\"" << std::endl;
+                return 1;
+            }
+            std::vector<std::string> samples;
+            std::string sample;
+            while (std::getline(profileStream, sample)) samples.push_back(sample);
+
+            StatsPhase reorderPhase("reorder");
+            dfa->reorderStates(samples);
+        }
+        else if (reorder) {
+            StatsPhase reorderPhase("reorder");
+            dfa->reorderStates();
+        }
+    }
+
+    StatsPhase matchPhase("match");
 
     // perform matching
     for (std::string matchCase : matchCases) {
         std::cout << "OUTPUT ";
 
-        auto match = dfa.match(matchCase);
+        auto match = dfa.has_value() ? dfa->match(matchCase) : nfa.match(matchCase);
         if (match.first)
             std::cout << ":M:";
         else 
             std::cout << match.second;
         std::cout << std::endl;
     }
+    matchPhase.stop();
+
+    // search for matches anywhere in the given file
+    if (searchFile.size() > 0) {
+        StatsPhase phase("search");
+        try {
+            MappedFile searchMap(searchFile, "search file");
+            std::string_view text = searchMap.view();
+
+            // the search automaton is built under the same limits as the DFA
+            std::optional<DFASearch> searcher;
+            if (dfa.has_value()) {
+                try {
+                    searcher.emplace(*dfa, limits);
+                } catch(int code) {
+                    if (code != 4 || !fallback) return code;
+                    std::cerr << "WARNING: falling back to matching the DFA from every candidate position" << std::endl;
+                }
+            }
+
+            if (searcher.has_value()) {
+                searcher->search(text, [](size_t start, size_t end) {
+                    std::cout << "MATCH " << start << " " << end << "\n";
+                });
+            }
+            else if (dfa.has_value()) {
+                for (std::pair<size_t, size_t> span : dfa->findAll(text)) {
+                    std::cout << "MATCH " << span.first << " " << span.second << "\n";
+                }
+            }
+            else {
+                for (std::pair<size_t, size_t> span : nfa.findAll(text)) {
+                    std::cout << "MATCH " << span.first << " " << span.second << "\n";
+                }
+            }
+        } catch(int code) {
+            return code;
+        }
+        std::cout.flush();
+    }
 
     // output the optimized DFA transition table
+    if (!dfa.has_value()) return 0;
+    StatsPhase outputPhase("output");
     std::ofstream outputFile(dfaFile);
-    outputFile << dfa.formatTableForAssignmentOutput();
+    outputFile << dfa->formatTableForAssignmentOutput();
     outputFile.close();
 
+    if (directFile.size() > 0) {
+        std::ofstream directOutput(directFile);
+        if (!directOutput.good()) {
+            std::cerr << "ERROR: could not write to matcher file \"" << directFile << "\"" << std::endl;
+            return 1;
+        }
+        // the namespace is named after the file, e.g. id_matcher.h declares id_matcher::matches
+        std::string stem = directFile.substr(directFile.find_last_of('/') + 1);
+        writeDirectMatcherHeader(directOutput, *dfa, cppIdentifier(stem.substr(0, stem.find('.'))), nfaFile);
+    }
+
     return 0;
 }
@@ -0,0 +1,278 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <common/lexer.h>
+#include <common/cfg.h>
+#include <common/tokenqueue.h>
+#include <common/stats.h>
+#include <common/trace.h>
+
+// pulls tokens from the lexer and escapes their values the way token files do, reusing one
+// token's buffers for every value
+class EscapedLexerStream : public LexerStream {
+    private:
+        token escaped;
+    public:
+        EscapedLexerStream(Lexer& lexer, const std::string& inputStr) : LexerStream(lexer, inputStr) {}
+        const token* next() override {
+            const token* tok = LexerStream::next();
+            if (tok == nullptr) return nullptr;
+            escaped.type = tok->type;
+            escaped.offset = tok->offset;
+            escaped.extent = tok->extent;
+            escaped.value.clear();
+            appendCleanSrcFormat(escaped.value, tok->value);
+            return &escaped;
+        }
+};
+
+// the tokens the parser sees: skipped types dropped and values escaped like token files
+std::vector<token> _parserTokens(const std::vector<token>& tokenStream, const std::set<std::string>& skipped) {
+    std::vector<token> out;
+    out.reserve(tokenStream.size());
+    for (const token& tok : tokenStream) {
+        if (skipped.find(tok.type) != skipped.end()) continue;
+        token& t = out.emplace_back();
+        t.type = tok.type;
+        t.offset = tok.offset;
+        t.extent = tok.extent;
+        appendCleanSrcFormat(t.value, tok.value);
+    }
+    return out;
+}
+
+bool _sameToken(const token& a, const token& b) {
+    return a.type == b.type && a.value == b.value;
+}
+
+// a preorder walk with depths pins down a tree, so two trees match when their walks do
+bool _sameTree(ParseTree& a, ParseTree& b) {
+    TreeWalker walkA = a.preorder(a.rootNode());
+    TreeWalker walkB = b.preorder(b.rootNode());
+    tree_visit va, vb;
+    while (true) {
+        bool moreA = walkA.next(va);
+        bool moreB = walkB.next(vb);
+        if (moreA != moreB) return false;
+        if (!moreA) return true;
+        if (va.depth != vb.depth || a.getLabel(va.node) != b.getLabel(vb.node)) return false;
+        if (a.getMetadata(va.node)->value != b.getMetadata(vb.node)->value) return false;
+    }
+}
+
+// parses src, then turns it into edited the way an editor would: the changed span is relexed
+// with Lexer::retokenize and only the parse around the changed tokens is redone with
+// CFG::rematch. With verify, both steps are checked against a full lex and parse of edited
+bool _matchEdited(Lexer& lex, CFG& cfg, ParseSession& session, const std::string& src, const std::string& edited, const std::set<std::string>& skipped, bool verify) {
+    StatsPhase parsePhase("lex and parse");
+    std::vector<token> tokenStream = lex.tokenize(src);
+    session.tokens = _parserTokens(tokenStream, skipped);
+    cfg.match(session);
+    parsePhase.stop();
+
+    // the edit is whatever lies between the longest common prefix and suffix of the two sources
+    size_t shorter = std::min(src.size(), edited.size());
+    size_t prefix = 0;
+    while (prefix < shorter && src[prefix] == edited[prefix]) prefix++;
+    size_t suffix = 0;
+    while (suffix < shorter - prefix && src[src.size() - 1 - suffix] == edited[edited.size() - 1 - suffix]) suffix++;
+    int deleted = src.size() - prefix - suffix;
+    int inserted = edited.size() - prefix - suffix;
+
+    StatsPhase retokenizePhase("retokenize");
+    std::vector<token> editedStream = lex.retokenize(tokenStream, edited, prefix, deleted, inserted);
+    std::vector<token> editedTokens = _parserTokens(editedStream, skipped);
+    retokenizePhase.stop();
+
+    // and likewise for the tokens the parser sees
+    std::vector<token>& oldTokens = session.tokens;
+    size_t shorterTokens = std::min(oldTokens.size(), editedTokens.size());
+    size_t firstToken = 0;
+    while (firstToken < shorterTokens && _sameToken(oldTokens[firstToken], editedTokens[firstToken])) firstToken++;
+    size_t lastTokens = 0;
+    while (lastTokens < shorterTokens - firstToken
+           && _sameToken(oldTokens[oldTokens.size() - 1 - lastTokens], editedTokens[editedTokens.size() - 1 - lastTokens])) {
+        lastTokens++;
+    }
+    int removedTokens = oldTokens.size() - firstToken - lastTokens;
+    int insertedTokens = editedTokens.size() - firstToken - lastTokens;
+    statsSet("edited tokens", insertedTokens);
+
+    StatsPhase rematchPhase("rematch");
+    session.tokens = std::move(editedTokens);
+    bool accepted = cfg.rematch(session, firstToken, removedTokens, insertedTokens);
+    rematchPhase.stop();
+
+    if (verify) {
+        StatsPhase verifyPhase("verify");
+        std::vector<token> fullStream = lex.tokenize(edited);
+        bool sameTokens = fullStream.size() == editedStream.size();
+        for (int i = 0; sameTokens && i < fullStream.size(); i++) {
+            sameTokens = _sameToken(fullStream[i], editedStream[i]) && fullStream[i].offset == editedStream[i].offset;
+        }
+        if (!sameTokens) {
+            std::cerr << "ERROR: retokenizing the edit gave different tokens than lexing the edited source" << std::endl;
+            throw 1;
+        }
+
+        ParseSession full;
+        full.tokens = _parserTokens(fullStream, skipped);
+        bool fullAccepted = cfg.match(full);
+        if (fullAccepted != accepted || (accepted && !_sameTree(session.tree, full.tree))) {
+            std::cerr << "ERROR: rematching the edit gave a different parse than parsing the edited source" << std::endl;
+            throw 1;
+        }
+    }
+    return accepted;
+}
+
+void printHelp() {
+    std::cout << "USAGE:" << std::endl;
+    std::cout << "\tPIPELINE [DEFINITION_PATH] [GRAMMAR_PATH] [PROGRAM_SRC] [GRAPHVIZ_OUTPUT] [--skip TOKEN]... [--serial] [--edit EDITED_SRC [--verify]] [--stats[=json]]" << std::endl;
+    std::cout << "\t--skip TOKEN\tdrop tokens of this type (e.g. whitespace) before parsing" << std::endl;
+    std::cout << "\t--serial\tlex on the parser's thread, one token at a time as it asks for them" << std::endl;
+    std::cout << "\t--edit EDITED_SRC\tafter parsing PROGRAM_SRC, reparse EDITED_SRC incrementally and output its tree" << std::endl;
+    std::cout << "\t--verify\twith --edit, check the incremental result against a full parse of EDITED_SRC" << std::endl;
+    std::cout << "\t--stats[=json]\treport phase timings, tree size and peak memory on stderr" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    statsInit(argc, argv);
+
+    // flags may appear anywhere, everything else is positional
+    std::set<std::string> skipped;
+    bool serial = false;
+    std::string editFile;
+    bool verify = false;
+    std::vector<std::string> args;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--skip" && i + 1 < argc) skipped.insert(argv[++i]);
+        else if (arg == "--serial") serial = true;
+        else if (arg == "--edit" && i + 1 < argc) editFile = argv[++i];
+        else if (arg == "--verify") verify = true;
+        else args.push_back(arg);
+    }
+
+    if (args.size() < 1) {
+        std::cerr << "ERROR: expected lexer token definition file path in argument 1" << std::endl;
+        printHelp();
+        return 1;
+    }
+    if (args.size() < 2) {
+        std::cerr << "ERROR: expected grammar file path in argument 2" << std::endl;
+        printHelp();
+        return 1;
+    }
+    if (args.size() < 3) {
+        std::cerr << "ERROR: expected program source file path in argument 3" << std::endl;
+        printHelp();
+        return 1;
+    }
+    if (args.size() < 4) {
+        std::cerr << "ERROR: expected graphviz output file path in argument 4" << std::endl;
+        printHelp();
+        return 1;
+    }
+
+    std::string defFile = args[0];
+    std::string grammarFile = args[1];
+    std::string srcFile = args[2];
+    std::string gvFile = args[3];
+
+    try {
+        StatsPhase loadPhase("load scanner");
+        Lexer lex = Lexer::fromDefinitions(readTokenDefinitions(defFile));
+        loadPhase.stop();
+
+        StatsPhase grammarPhase("read grammar");
+        std::ifstream cfgStream(grammarFile);
+        if (!cfgStream.good()) {
+            std::cerr << "ERROR: could not access grammar file \"" << grammarFile << "\"" << std::endl;
+            throw 1;
+        }
+        CFG cfg = CFG::parse(cfgStream);
+        grammarPhase.stop();
+
+        StatsPhase readPhase("read source");
+        std::ifstream srcStream(srcFile);
+        if (!srcStream.good()) {
+            std::cerr << "ERROR: could not access program source file \"" << srcFile << "\"" << std::endl;
+            throw 1;
+        }
+        std::stringstream srcBuf;
+        srcBuf << srcStream.rdbuf();
+        std::string src = srcBuf.str();
+        readPhase.stop();
+        statsSet("source bytes", src.size());
+
+        ParseSession session;
+        bool accepted;
+        if (!editFile.empty()) {
+            std::ifstream editStream(editFile);
+            if (!editStream.good()) {
+                std::cerr << "ERROR: could not access edited source file \"" << editFile << "\"" << std::endl;
+                throw 1;
+            }
+            std::stringstream editBuf;
+            editBuf << editStream.rdbuf();
+            accepted = _matchEdited(lex, cfg, session, src, editBuf.str(), skipped, verify);
+        }
+        else {
+            // values look the way LGA would read them back from a token file
+            EscapedLexerStream stream(lex, src);
+            for (std::string type : skipped) stream.skipType(type);
+
+            // the two stages overlap, so they're only timed together
+            StatsPhase parsePhase("lex and parse");
+            if (serial) {
+                accepted = cfg.match(session, stream);
+            }
+            else {
+                // the lexer runs on its own thread and feeds the parser through the queue. A lexer
+                // error is rethrown by the queue where the parser would otherwise see the tokens run out,
+                // so no parse error is reported for a stream that was cut short
+                TokenQueue queue;
+                std::thread lexThread([&]() {
+                    TRACE_SCOPE("PIPELINE lexer thread");
+                    int lexError = 0;
+                    try {
+                        while (const token* tok = stream.next()) {
+                            if (!queue.push(*tok)) return;
+                        }
+                    } catch (int e) {
+                        lexError = e;
+                    }
+                    queue.close(lexError);
+                });
+
+                try {
+                    accepted = cfg.match(session, queue);
+                } catch (int) {
+                    queue.abandon();
+                    lexThread.join();
+                    throw;
+                }
+                queue.abandon();
+                lexThread.join();
+            }
+            parsePhase.stop();
+        }
+        statsSet("tree nodes", session.tree.size());
+
+        StatsPhase outputPhase("output");
+
+        std::cout << "MATCH: " << (accepted ? "TRUE" : "FALSE") << std::endl;
+        cfg.printParseTree(session.tree);
+        cfg.saveGraphvizTree(gvFile, session.tree);
+        if (!accepted) return 1;
+    } catch(int e) {
+        return e;
+    }
+
+    return 0;
+}
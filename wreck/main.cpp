@@ -7,6 +7,9 @@
 #include <common/cfg.h>
 #include <common/regex.h>
 #include <common/nfa.h>
+#include <common/stats.h>
+#include <common/scanner.h>
+#include <common/codegen.h>
 
 struct toktable {
     std::string regex;
@@ -81,42 +84,111 @@ tokdefs readTokenConfig(std::string path) {
 
 void printHelp() {
     std::cout << "USAGE:" << std::endl;
-    std::cout << "\tWRECK [CONFIG_PATH] [DEFINITION_PATH]" << std::endl;
+    std::cout << "\tWRECK [CONFIG_PATH] [DEFINITION_PATH] [--glushkov] [--max-states N] [--max-bytes N] [--emit-header FILE] [--emit-direct FILE] [--stats[=json]]" << std::endl;
+    std::cout << "\t--glushkov\temit lambda-free position automata instead of Thompson NFAs" << std::endl;
+    std::cout << "\t--max-states N\treject tokens whose DFA would need more than N states" << std::endl;
+    std::cout << "\t--max-bytes N\treject tokens whose subset construction would need more than about N bytes" << std::endl;
+    std::cout << "\t--emit-header FILE\twrite a C++ header with a constexpr combined scanner for the token set" << std::endl;
+    std::cout << "\t--emit-direct FILE\tthe same scanner as direct-coded C++ (a goto per transition, no tables)" << std::endl;
+    std::cout << "\t--stats[=json]\treport phase timings, automaton sizes and peak memory on stderr" << std::endl;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
+    statsInit(argc, argv);
+
+    // flags may appear anywhere, everything else is positional
+    bool glushkov = false;
+    dfa_limits limits;
+    std::string headerFile;
+    std::string directFile;
+    std::vector<std::string> args;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--glushkov") glushkov = true;
+        else if (arg == "--emit-header" && i + 1 < argc) headerFile = argv[++i];
+        else if (arg == "--emit-direct" && i + 1 < argc) directFile = argv[++i];
+        else if ((arg == "--max-states" || arg == "--max-bytes") && i + 1 < argc) {
+            size_t limit;
+            if (!parseLimit(argv[++i], limit)) {
+                std::cerr << "ERROR: expected a non-negative number after " << arg << std::endl;
+                return 1;
+            }
+            if (arg == "--max-states") limits.maxStates = limit;
+            else limits.maxBytes = limit;
+        }
+        else args.push_back(arg);
+    }
+
+    if (args.size() < 1) {
         std::cerr << "ERROR: expected lexer token definition file path in argument 1" << std::endl;
         printHelp();
         return 1;
     }
-    if (argc < 3) {
+    if (args.size() < 2) {
         std::cerr << "ERROR: expected program source file path in argument 2" << std::endl;
         printHelp();
         return 1;
     }
 
-    std::string configFile = argv[1];
-    std::string scanFile = argv[2];
+    std::string configFile = args[0];
+    std::string scanFile = args[1];
 
+    // token configs often repeat a regex under several token names, only compile each once
+    RegexCache regexCache;
+    ParseSession regexSession;
     std::map<int, std::string> rsmap = llre().getReverseSymbolMap();
 
     tokdefs def;
     try {
+        StatsPhase phase("read config");
         def = readTokenConfig(configFile);
     } catch(int e) {
         return e;
     }
 
+    int tooLarge = 0;
+    std::vector<DFA> tokenDfas;
     for (toktable tab : def.tables) {
         // std::cout << "TOK: " << tab.token << "; REGEX: " << tab.regex << std::endl;
         // if (tab.data.size() > 0) std::cout << "\tDATA: " << tab.data << std::endl;
         
         try {
-            ParseTree regexAst = parseRegex(tab.regex);
-            NFABuilder nfa = nfaRegex(regexAst, def.alphabet, rsmap);
-            Definition nfaDef = nfa.toDefinition(def.alphabet);
-            
+            Definition nfaDef;
+            if (glushkov) {
+                StatsPhase parsePhase("regex parse");
+                ParseTree& regexAst = parseRegex(tab.regex, regexSession);
+                simplifyRegex(regexAst);
+                parsePhase.stop();
+                StatsPhase buildPhase("nfa build");
+                nfaDef = glushkovRegex(regexAst, def.alphabet, rsmap);
+            }
+            else {
+                NFABuilder& nfa = regexCache.compile(tab.regex, def.alphabet);
+                StatsPhase buildPhase("nfa build");
+                nfaDef = nfa.toDefinition(def.alphabet);
+            }
+            statsCount("tokens");
+            statsCount("nfa states", nfaDef.head.stateCount);
+
+            // determinize up front so a regex that would blow up NFAMATCH is caught here, by name
+            bool combine = !headerFile.empty() || !directFile.empty();
+            if (limits.maxStates > 0 || limits.maxBytes > 0 || combine) {
+                StatsPhase subsetPhase("subset construction");
+                try {
+                    DFA dfa = NFA(nfaDef).toDFA(limits);
+                    if (combine) {
+                        dfa.optimize();
+                        tokenDfas.push_back(dfa);
+                    }
+                } catch(int e) {
+                    if (e != 4) throw;
+                    std::cerr << "ERROR: token " << tab.token << " (" << tab.regex << ") is too large to determinize" << std::endl;
+                    tooLarge++;
+                    continue;
+                }
+            }
+
+            StatsPhase outputPhase("output");
             std::ostringstream oss;
             oss << tab.token << ".nfa";
             std::ofstream defOutput(oss.str());
@@ -131,7 +203,44 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (tooLarge > 0) return 4;
+
+    if (!headerFile.empty() || !directFile.empty()) {
+        std::vector<std::string> names;
+        std::vector<std::string> values;
+        for (toktable tab : def.tables) {
+            names.push_back(tab.token);
+            values.push_back(tab.data);
+        }
+
+        try {
+            StatsPhase combinePhase("combine scanner");
+            ScannerTable scanner(def.alphabet, tokenDfas, limits);
+            combinePhase.stop();
+            statsSet("scanner states", scanner.stateCount());
+
+            StatsPhase outputPhase("output");
+            for (std::string path : { headerFile, directFile }) {
+                if (path.empty()) continue;
+                std::ofstream header(path);
+                if (!header.good()) {
+                    std::cerr << "ERROR: could not write to header file \"" << path << "\"" << std::endl;
+                    return 1;
+                }
+                // the namespace is named after the header, e.g. kw_scanner.h declares kw_scanner::tokenize
+                std::string stem = path.substr(path.find_last_of('/') + 1);
+                stem = cppIdentifier(stem.substr(0, stem.find('.')));
+                if (path == directFile) writeDirectScannerHeader(header, scanner, names, values, stem, configFile);
+                else writeScannerHeader(header, scanner, names, values, stem, configFile);
+            }
+        } catch(int e) {
+            return e;
+        }
+    }
+    if (!glushkov) statsSet("distinct regexes", regexCache.size());
+
     // write output scan table file
+    StatsPhase outputPhase("output");
     std::ofstream scan(scanFile);
     if (!scan.good()) {
         std::cerr << "ERROR: could not write to scanner definition file \"" << scanFile << "\"" << std::endl;